@@ -5,118 +5,210 @@
 #include "Anim.h"
 #include "Anim/private/animMgr.h"
 #include "Core/Memory/Memory.h"
+#if ORYOL_HAS_THREADS
+#include <atomic>
+#endif
 
 namespace Oryol {
 
 using namespace _priv;
 
+struct AnimContext {
+    struct AnimSetup animSetup;
+    _priv::animMgr mgr;
+    /// number of threads on which the context is current
+    #if ORYOL_HAS_THREADS
+    std::atomic<int> numCurrentThreads{0};
+    #else
+    int numCurrentThreads = 0;
+    #endif
+};
+
 namespace {
-    struct _state {
-        struct AnimSetup animSetup;
-        _priv::animMgr mgr;    
-    };
-    _state* state = nullptr;
+    AnimContext* defaultContext = nullptr;
+    #if ORYOL_HAS_THREADS
+    thread_local AnimContext* currentContext = nullptr;
+    #else
+    AnimContext* currentContext = nullptr;
+    #endif
+
+    /// the context the facade functions work on
+    AnimContext* ctx() {
+        return currentContext ? currentContext : defaultContext;
+    }
 }
 
 //------------------------------------------------------------------------------
 void
 Anim::Setup(const struct AnimSetup& setup) {
-    o_assert_dbg(!IsValid());
-    state = Memory::New<_state>();
-    state->animSetup = setup;
-    state->mgr.setup(setup);
+    o_assert_dbg(!defaultContext);
+    defaultContext = CreateContext(setup);
 }
 
 //------------------------------------------------------------------------------
 void
 Anim::Discard() {
-    o_assert_dbg(IsValid());
-    state->mgr.discard();
-    Memory::Delete(state);
-    state = nullptr;
+    o_assert_dbg(defaultContext);
+    AnimContext* context = defaultContext;
+    defaultContext = nullptr;
+    DestroyContext(context);
 }
 
 //------------------------------------------------------------------------------
 bool
 Anim::IsValid() {
-    return (nullptr != state);
+    return (nullptr != ctx());
+}
+
+//------------------------------------------------------------------------------
+AnimContext*
+Anim::CreateContext(const struct AnimSetup& setup) {
+    AnimContext* context = Memory::New<AnimContext>();
+    context->animSetup = setup;
+    context->mgr.setup(setup);
+    return context;
+}
+
+//------------------------------------------------------------------------------
+void
+Anim::DestroyContext(AnimContext* context) {
+    o_assert_dbg(context && (context != defaultContext));
+    if (currentContext == context) {
+        MakeCurrentContext(nullptr);
+    }
+    o_assert2_dbg(0 == context->numCurrentThreads, "Anim::DestroyContext: context is still current on another thread!\n");
+    context->mgr.discard();
+    Memory::Delete(context);
+}
+
+//------------------------------------------------------------------------------
+void
+Anim::MakeCurrentContext(AnimContext* context) {
+    if (currentContext) {
+        currentContext->numCurrentThreads--;
+    }
+    currentContext = context;
+    if (currentContext) {
+        currentContext->numCurrentThreads++;
+    }
+}
+
+//------------------------------------------------------------------------------
+AnimContext*
+Anim::CurrentContext() {
+    return ctx();
+}
+
+//------------------------------------------------------------------------------
+AnimContext*
+Anim::DefaultContext() {
+    return defaultContext;
+}
+
+//------------------------------------------------------------------------------
+const struct AnimSetup&
+Anim::AnimSetup() {
+    o_assert_dbg(IsValid());
+    return ctx()->animSetup;
 }
 
 //------------------------------------------------------------------------------
 double
 Anim::CurrentTime() {
     o_assert_dbg(IsValid());
-    return state->mgr.curTime;
+    return ctx()->mgr.curTime;
 }
 
 //------------------------------------------------------------------------------
 ResourceLabel
 Anim::PushLabel() {
     o_assert_dbg(IsValid());
-    return state->mgr.resContainer.PushLabel();
+    return ctx()->mgr.resContainer.PushLabel();
 }
 
 //------------------------------------------------------------------------------
 void
 Anim::PushLabel(ResourceLabel label) {
     o_assert_dbg(IsValid());
-    state->mgr.resContainer.PushLabel(label);
+    ctx()->mgr.resContainer.PushLabel(label);
 }
 
 //------------------------------------------------------------------------------
 ResourceLabel
 Anim::PopLabel() {
     o_assert_dbg(IsValid());
-    return state->mgr.resContainer.PopLabel();
+    return ctx()->mgr.resContainer.PopLabel();
 }
 
 //------------------------------------------------------------------------------
 template<> Id
 Anim::Create(const AnimLibrarySetup& setup) {
     o_assert_dbg(IsValid());
-    return state->mgr.createLibrary(setup);
+    return ctx()->mgr.createLibrary(setup);
 }
 
 //------------------------------------------------------------------------------
 template<> Id
 Anim::Create(const AnimSkeletonSetup& setup) {
     o_assert_dbg(IsValid());
-    return state->mgr.createSkeleton(setup);
+    return ctx()->mgr.createSkeleton(setup);
 }
 
 //------------------------------------------------------------------------------
 template<> Id
 Anim::Create(const AnimInstanceSetup& setup) {
     o_assert_dbg(IsValid());
-    return state->mgr.createInstance(setup);
+    return ctx()->mgr.createInstance(setup);
+}
+
+//------------------------------------------------------------------------------
+Id
+Anim::CloneInstance(const Id& instId) {
+    Id resId;
+    CloneInstances(instId, 1, &resId);
+    return resId;
+}
+
+//------------------------------------------------------------------------------
+int
+Anim::CloneInstances(const Id& instId, int num, Id* outIds) {
+    o_assert_dbg(IsValid());
+    o_assert_dbg(outIds && (num >= 0));
+    const animInstance* inst = ctx()->mgr.lookupInstance(instId);
+    if (inst) {
+        return ctx()->mgr.cloneInstances(inst, num, outIds);
+    }
+    else {
+        return 0;
+    }
 }
 
 //------------------------------------------------------------------------------
 Id
 Anim::Lookup(const Locator& name) {
     o_assert_dbg(IsValid());
-    return state->mgr.resContainer.Lookup(name);
+    return ctx()->mgr.resContainer.Lookup(name);
 }
 
 //------------------------------------------------------------------------------
 void
 Anim::Destroy(ResourceLabel label) {
     o_assert_dbg(IsValid());
-    return state->mgr.destroy(label);
+    return ctx()->mgr.destroy(label);
 }
 
 //------------------------------------------------------------------------------
 bool
 Anim::HasLibrary(const Id& libId) {
     o_assert_dbg(IsValid());
-    return nullptr != state->mgr.lookupLibrary(libId);
+    return nullptr != ctx()->mgr.lookupLibrary(libId);
 }
 
 //------------------------------------------------------------------------------
 const AnimLibrary&
 Anim::Library(const Id& libId) {
     o_assert_dbg(IsValid());
-    const AnimLibrary* lib = state->mgr.lookupLibrary(libId);
+    const AnimLibrary* lib = ctx()->mgr.lookupLibrary(libId);
     if (lib) {
         return *lib;
     }
@@ -126,31 +218,94 @@ Anim::Library(const Id& libId) {
     }
 }
 
+//------------------------------------------------------------------------------
+int
+Anim::ClipIndex(const Id& libId, const StringAtom& clipName) {
+    o_assert_dbg(IsValid());
+    const AnimLibrary* lib = ctx()->mgr.lookupLibrary(libId);
+    if (lib && lib->ClipIndexMap.Contains(clipName)) {
+        return lib->ClipIndexMap[clipName];
+    }
+    else {
+        return InvalidIndex;
+    }
+}
+
 //------------------------------------------------------------------------------
 void
 Anim::WriteKeys(const Id& libId, const uint8_t* ptr, int numBytes) {
     o_assert_dbg(IsValid());
-    AnimLibrary* lib = state->mgr.lookupLibrary(libId);
+    AnimLibrary* lib = ctx()->mgr.lookupLibrary(libId);
     if (lib) {
-        state->mgr.writeKeys(lib, ptr, numBytes);
+        ctx()->mgr.writeKeys(lib, ptr, numBytes);
     }
     else {
         o_warn("Anim::WriteKeys: invalid anim lib id\n");
     }
 }
 
+//------------------------------------------------------------------------------
+bool
+Anim::ReloadLibrary(const Id& libId, const AnimLibrarySetup& setup, const uint8_t* ptr, int numBytes) {
+    o_assert_dbg(IsValid());
+    AnimLibrary* lib = ctx()->mgr.lookupLibrary(libId);
+    if (lib) {
+        return ctx()->mgr.reloadLibrary(lib, setup, ptr, numBytes);
+    }
+    else {
+        o_warn("Anim::ReloadLibrary: invalid anim lib id\n");
+        return false;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+Anim::SampleClip(const Id& libId, int clipIndex, double time, float* out) {
+    SampleClip(libId, clipIndex, &time, 1, out);
+}
+
+//------------------------------------------------------------------------------
+void
+Anim::SampleClip(const Id& libId, int clipIndex, const double* times, int numTimes, float* out) {
+    o_assert_dbg(IsValid());
+    const AnimLibrary* lib = ctx()->mgr.lookupLibrary(libId);
+    if (lib) {
+        o_assert_range_dbg(clipIndex, lib->Clips.Size());
+        ctx()->mgr.sampleClip(lib, clipIndex, times, numTimes, out);
+    }
+    else {
+        o_warn("Anim::SampleClip: invalid anim lib id\n");
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+Anim::BakeSkinMatrices(const Id& libId, int clipIndex, const Id& skelId) {
+    o_assert_dbg(IsValid());
+    AnimLibrary* lib = ctx()->mgr.lookupLibrary(libId);
+    AnimSkeleton* skel = ctx()->mgr.lookupSkeleton(skelId);
+    if (lib && skel) {
+        o_assert_range_dbg(clipIndex, lib->Clips.Size());
+        return ctx()->mgr.bakeSkinMatrices(lib, clipIndex, skel);
+    }
+    else {
+        o_warn("Anim::BakeSkinMatrices: invalid anim lib or skeleton id\n");
+        return false;
+    }
+}
+
 //------------------------------------------------------------------------------
 bool
 Anim::HasSkeleton(const Id& skelId) {
     o_assert_dbg(IsValid());
-    return nullptr != state->mgr.lookupSkeleton(skelId);
+    return nullptr != ctx()->mgr.lookupSkeleton(skelId);
 }
 
 //------------------------------------------------------------------------------
 const AnimSkeleton&
 Anim::Skeleton(const Id& skelId) {
     o_assert_dbg(IsValid());
-    const AnimSkeleton* skel = state->mgr.lookupSkeleton(skelId);
+    const AnimSkeleton* skel = ctx()->mgr.lookupSkeleton(skelId);
     if (skel) {
         return *skel;
     }
@@ -164,16 +319,42 @@ Anim::Skeleton(const Id& skelId) {
 void
 Anim::NewFrame() {
     o_assert_dbg(IsValid());
-    state->mgr.newFrame();
+    ctx()->mgr.newFrame();
 }
 
 //------------------------------------------------------------------------------
 bool
 Anim::AddActiveInstance(const Id& instId) {
     o_assert_dbg(IsValid());
-    animInstance* inst = state->mgr.lookupInstance(instId);
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
     if (inst) {
-        return state->mgr.addActiveInstance(inst);
+        return ctx()->mgr.addActiveInstance(inst);
+    }
+    else {
+        return false;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+Anim::AddActiveInstance(const Id& instId, float* samplesDst, float* skinMatricesDst, int lod) {
+    o_assert_dbg(IsValid());
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
+    if (inst) {
+        return ctx()->mgr.addActiveInstance(inst, samplesDst, skinMatricesDst, lod);
+    }
+    else {
+        return false;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+Anim::AddActiveInstance(const Id& instId, int lod) {
+    o_assert_dbg(IsValid());
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
+    if (inst) {
+        return ctx()->mgr.addActiveInstance(inst, nullptr, nullptr, lod);
     }
     else {
         return false;
@@ -184,14 +365,14 @@ Anim::AddActiveInstance(const Id& instId) {
 void
 Anim::Evaluate(double frameDurationInSeconds) {
     o_assert_dbg(IsValid());
-    state->mgr.evaluate(frameDurationInSeconds);
+    ctx()->mgr.evaluate(frameDurationInSeconds);
 }
 
 //------------------------------------------------------------------------------
 const Slice<float>&
 Anim::Samples(const Id& instId) {
     o_assert_dbg(IsValid());
-    animInstance* inst = state->mgr.lookupInstance(instId);
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
     if (inst) {
         return inst->samples;
     }
@@ -201,20 +382,61 @@ Anim::Samples(const Id& instId) {
     }
 }
 
+//------------------------------------------------------------------------------
+const Slice<float>&
+Anim::Velocities(const Id& instId) {
+    o_assert_dbg(IsValid());
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
+    if (inst) {
+        return inst->velocities;
+    }
+    else {
+        static Slice<float> dummySlice;
+        return dummySlice;
+    }
+}
+
+//------------------------------------------------------------------------------
+const glm::vec4&
+Anim::RootMotion(const Id& instId) {
+    o_assert_dbg(IsValid());
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
+    if (inst) {
+        return inst->rootMotion;
+    }
+    else {
+        static glm::vec4 dummyRootMotion;
+        return dummyRootMotion;
+    }
+}
+
 //------------------------------------------------------------------------------
 const AnimSkinMatrixInfo&
 Anim::SkinMatrixInfo() {
     o_assert_dbg(IsValid());
-    return state->mgr.skinMatrixInfo;
+    return ctx()->mgr.skinMatrixInfo;
+}
+
+//------------------------------------------------------------------------------
+bool
+Anim::IsDirty(const Id& instId) {
+    o_assert_dbg(IsValid());
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
+    if (inst) {
+        return inst->dirty;
+    }
+    else {
+        return false;
+    }
 }
 
 //------------------------------------------------------------------------------
 AnimJobId
 Anim::Play(const Id& instId, const AnimJob& job) {
     o_assert_dbg(IsValid());
-    animInstance* inst = state->mgr.lookupInstance(instId);
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
     if (inst) {
-        return state->mgr.play(inst, job);
+        return ctx()->mgr.play(inst, job);
     }
     else {
         return InvalidAnimJobId;
@@ -225,9 +447,9 @@ Anim::Play(const Id& instId, const AnimJob& job) {
 void
 Anim::Stop(const Id& instId, AnimJobId jobId, bool allowFadeOut) {
     o_assert_dbg(IsValid());
-    animInstance* inst = state->mgr.lookupInstance(instId);
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
     if (inst) {
-        state->mgr.stop(inst, jobId, allowFadeOut);
+        ctx()->mgr.stop(inst, jobId, allowFadeOut);
     }
 }
 
@@ -235,9 +457,9 @@ Anim::Stop(const Id& instId, AnimJobId jobId, bool allowFadeOut) {
 void
 Anim::StopTrack(const Id& instId, int trackIndex, bool allowFadeOut) {
     o_assert_dbg(IsValid());
-    animInstance* inst = state->mgr.lookupInstance(instId);
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
     if (inst) {
-        state->mgr.stopTrack(inst, trackIndex, allowFadeOut);
+        ctx()->mgr.stopTrack(inst, trackIndex, allowFadeOut);
     }
 }
 
@@ -245,9 +467,35 @@ Anim::StopTrack(const Id& instId, int trackIndex, bool allowFadeOut) {
 void
 Anim::StopAll(const Id& instId, bool allowFadeOut) {
     o_assert_dbg(IsValid());
-    animInstance* inst = state->mgr.lookupInstance(instId);
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
     if (inst) {
-        state->mgr.stopAll(inst, allowFadeOut);
+        ctx()->mgr.stopAll(inst, allowFadeOut);
+    }
+}
+
+//------------------------------------------------------------------------------
+int
+Anim::EncodeState(const Id& instId, uint8_t* dst, int maxBytes, const uint8_t* baseline, int baselineBytes) {
+    o_assert_dbg(IsValid());
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
+    if (inst) {
+        return ctx()->mgr.encodeState(inst, dst, maxBytes, baseline, baselineBytes);
+    }
+    else {
+        return 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+Anim::DecodeState(const Id& instId, const uint8_t* src, int numBytes, const uint8_t* baseline, int baselineBytes) {
+    o_assert_dbg(IsValid());
+    animInstance* inst = ctx()->mgr.lookupInstance(instId);
+    if (inst) {
+        return ctx()->mgr.decodeState(inst, src, numBytes, baseline, baselineBytes);
+    }
+    else {
+        return false;
     }
 }
 
@@ -255,7 +503,7 @@ Anim::StopAll(const Id& instId, bool allowFadeOut) {
 const animInstance&
 Anim::instance(const Id& instId) {
     o_assert_dbg(IsValid());
-    const animInstance* inst = state->mgr.lookupInstance(instId);
+    const animInstance* inst = ctx()->mgr.lookupInstance(instId);
     if (inst) {
         return *inst;
     }
@@ -13,14 +13,28 @@
 
 namespace Oryol {
 
+/// opaque animation context (an independent animation world)
+struct AnimContext;
+
 class Anim {
 public:
-    /// setup the animation module
-    static void Setup(const AnimSetup& setup = AnimSetup());
-    /// discard the animation module
+    /// setup the animation module (creates the default context)
+    static void Setup(const struct AnimSetup& setup = Oryol::AnimSetup());
+    /// discard the animation module (destroys the default context)
     static void Discard();
-    /// check if animation module is setup
+    /// check if animation module is setup (or a context is current)
     static bool IsValid();
+
+    /// create an independent animation context
+    static AnimContext* CreateContext(const struct AnimSetup& setup = Oryol::AnimSetup());
+    /// destroy an animation context (not the default context), other threads must have made a different context current before
+    static void DestroyContext(AnimContext* context);
+    /// make a context current on the calling thread (nullptr for the default context)
+    static void MakeCurrentContext(AnimContext* context);
+    /// get the context the calling thread is working on
+    static AnimContext* CurrentContext();
+    /// get the default context (nullptr if Anim::Setup() wasn't called)
+    static AnimContext* DefaultContext();
     /// get the original AnimSetup object
     static const struct AnimSetup& AnimSetup();
     /// get the animation systems current absolute time
@@ -35,6 +49,10 @@ public:
 
     /// create an anim resource object
     template<class SETUP> static Id Create(const SETUP& setup);
+    /// create a copy of an anim instance (including its anim jobs)
+    static Id CloneInstance(const Id& instId);
+    /// create several copies of an anim instance, return number of created instances
+    static int CloneInstances(const Id& instId, int num, Id* outIds);
     /// lookup an resource id by name 
     static Id Lookup(const Locator& name);
     /// destroy one or several anim resources by label
@@ -44,10 +62,19 @@ public:
     static bool HasLibrary(const Id& libId);
     /// access an animation library
     static const AnimLibrary& Library(const Id& libId);
-    /// lookup a clip index by name
+    /// lookup a clip index by name (InvalidIndex if the library has no such clip)
     static int ClipIndex(const Id& libId, const StringAtom& clipName);
     /// write anim library keys
     static void WriteKeys(const Id& libId, const uint8_t* ptr, int numBytes);
+    /// replace clips and keys of a library in place (same clip count and curve layout), instances keep playing
+    static bool ReloadLibrary(const Id& libId, const AnimLibrarySetup& setup, const uint8_t* ptr, int numBytes);
+
+    /// sample a clip at a clip-relative time into out (lib.SampleStride floats), without an instance, exact at key times
+    static void SampleClip(const Id& libId, int clipIndex, double time, float* out);
+    /// sample a clip at many clip-relative times into out (numTimes * lib.SampleStride floats), on persistent worker threads
+    static void SampleClip(const Id& libId, int clipIndex, const double* times, int numTimes, float* out);
+    /// bake per-key skin matrices of a clip for a skeleton, played by instances added with AnimConfig::BakedClipLod
+    static bool BakeSkinMatrices(const Id& libId, int clipIndex, const Id& skelId);
 
     /// return true if a valid anim skeleton exists for id
     static bool HasSkeleton(const Id& skelId);
@@ -58,12 +85,22 @@ public:
     static void NewFrame();
     /// add an active instance for the current frame
     static bool AddActiveInstance(const Id& instId);
+    /// add an active instance which evaluates into caller-owned memory (lib.SampleStride floats, skel.NumBones*12 floats, nullptr for internal)
+    static bool AddActiveInstance(const Id& instId, float* samplesDst, float* skinMatricesDst, int lod=0);
+    /// add an active instance which samples reduced-rate clip LODs (0 is full rate, see AnimClipSetup::NumLods)
+    static bool AddActiveInstance(const Id& instId, int lod);
     /// evaluate all active animation instances
     static void Evaluate(double frameDurationInSeconds);
     /// access to current samples of an active anim instance (valid after Anim::Evaluate())
     static const Slice<float>& Samples(const Id& instId);
+    /// access to sample velocities (per second) of an active anim instance created with Velocities (valid after Anim::Evaluate())
+    static const Slice<float>& Velocities(const Id& instId);
+    /// access to root motion translation since previous evaluation of an active anim instance (valid after Anim::Evaluate())
+    static const glm::vec4& RootMotion(const Id& instId);
     /// access to evaluated skeleton skinning matrix info
     static const AnimSkinMatrixInfo& SkinMatrixInfo();
+    /// return true if the last Anim::Evaluate() rewrote the outputs of an active instance (also for caller-owned buffers)
+    static bool IsDirty(const Id& instId);
 
     /// enqueue an animation job, return job id
     static AnimJobId Play(const Id& instId, const AnimJob& job);
@@ -74,6 +111,11 @@ public:
     /// stop all jobs
     static void StopAll(const Id& instId, bool allowFadeOut=true);
 
+    /// encode an instance's anim jobs into a compact byte stream, optionally as delta to a baseline, return num bytes
+    static int EncodeState(const Id& instId, uint8_t* dst, int maxBytes, const uint8_t* baseline=nullptr, int baselineBytes=0);
+    /// decode anim jobs into an instance (baseline must be the same as used for encoding), fails without changes on invalid streams
+    static bool DecodeState(const Id& instId, const uint8_t* src, int numBytes, const uint8_t* baseline=nullptr, int baselineBytes=0);
+
     /// access to anim instance
     static const _priv::animInstance& instance(const Id& instId);
 };
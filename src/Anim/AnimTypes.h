@@ -25,6 +25,25 @@ struct AnimConfig {
     static const int MaxNumSkeletonBones = 256;
     /// max number of curves in a clip
     static const int MaxNumCurvesInClip = MaxNumSkeletonBones * 3;
+    /// max number of reduced-rate LODs per clip (LOD n has every (1<<n)-th key)
+    static const int MaxNumClipLods = 2;
+    /// instance LOD which plays baked skin matrices if available (otherwise the lowest clip LOD)
+    static const int BakedClipLod = MaxNumClipLods + 1;
+    /// max number of pose basis vectors of a library
+    static const int MaxPoseBasisSize = 64;
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimEvalMode
+    @ingroup Anim
+    @brief how animation samples and skinning matrices are computed
+*/
+struct AnimEvalMode {
+    enum Enum {
+        Float,      ///< floating point evaluation (default)
+        FixedPoint, ///< deterministic fixed-point evaluation (for lockstep simulation)
+    };
 };
 
 //------------------------------------------------------------------------------
@@ -56,6 +75,22 @@ struct AnimSetup {
     int SkinMatrixTableWidth = 1024;
     /// skinning-matrix table height
     int SkinMatrixTableHeight = 64;
+    /// size of the pool for pre-decoded keys of frequently played clips in number of floats (0 to disable)
+    int HotKeyPoolCapacity = 0;
+    /// size of the shared cache of decoded key rows in number of floats (0 to disable)
+    int KeyCacheCapacity = 0;
+    /// evaluate active instances sorted by library, clip and skeleton (InstanceInfos keep the AddActiveInstance order)
+    bool SortActiveInstances = false;
+    /// min number of active instances playing the same single clip to sample them as a group (0 to disable)
+    int MinSampleGroupSize = 4;
+    /// min number of active instances sharing a skeleton to skin them as a group (0 to disable)
+    int MinSkinGroupSize = 4;
+    /// skip instances with unchanged evaluation inputs (their outputs must be left untouched)
+    bool SkipUnchangedInstances = false;
+    /// write skin matrices with non-temporal stores (bypassing the CPU cache, float mode only)
+    bool StreamSkinMatrices = false;
+    /// evaluation mode, FixedPoint is slower but bit-identical across builds
+    AnimEvalMode::Enum EvalMode = AnimEvalMode::Float;
     /// initial resource label stack capacity
     int ResourceLabelStackCapacity = 256;
     /// initial resource registry capacity
@@ -127,6 +162,10 @@ struct AnimClipSetup {
     double KeyDuration = 1.0 / 25.0;
     /// a description of each curve in the clip
     Array<AnimCurveSetup> Curves;
+    /// also keep pre-scaled (value, delta to next key) pairs for faster sampling
+    bool DeltaKeys = false;
+    /// number of reduced-rate LODs to build when keys are written (0..AnimConfig::MaxNumClipLods, ignored in pose basis libraries)
+    int NumLods = 0;
 
     /// default constructor
     AnimClipSetup() { };
@@ -143,6 +182,13 @@ struct AnimClipSetup {
 
     An animation library is a collection of compatible clips (clip 
     with the same anim curve layout).
+
+    With a PoseBasisSize > 0, the keys are compressed when they are
+    written: all key poses of the library are projected onto a shared
+    pose basis (principal components of the key poses), and only the
+    per-key basis coefficients are kept, the int16 keys are released
+    from the key pool. Keys of such a library can only be written once.
+    This isn't supported in AnimEvalMode::FixedPoint.
 */
 struct AnimLibrarySetup {
     /// resource locator for sharing
@@ -151,6 +197,12 @@ struct AnimLibrarySetup {
     Array<AnimCurveFormat::Enum> CurveLayout;
     /// the anim clips in the library
     Array<AnimClipSetup> Clips;
+    /// optional index of the root translation curve for root motion extraction
+    int RootMotionCurve = InvalidIndex;
+    /// which components of the root motion curve are extracted (1.0) or kept in the pose (0.0)
+    glm::vec4 RootMotionMask = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+    /// if > 0, keys are compressed into this many pose basis coefficients per key (see AnimLibrary::PoseBasis)
+    int PoseBasisSize = 0;
 };
 
 //------------------------------------------------------------------------------
@@ -168,6 +220,8 @@ struct AnimBoneSetup {
     glm::mat4 BindPose;
     /// the inverse bind pose matrix in model space
     glm::mat4 InvBindPose;
+    /// index of the mirrored bone (e.g. left hand for right hand), InvalidIndex if the bone mirrors itself
+    int16_t MirrorIndex = InvalidIndex;
 
     /// default constructor
     AnimBoneSetup() { };
@@ -187,6 +241,8 @@ struct AnimSkeletonSetup {
     class Locator Locator = Locator::NonShared();
     /// the skeleton bones
     Array<AnimBoneSetup> Bones; 
+    /// axis of the mirror plane normal (0=x, 1=y, 2=z), InvalidIndex if the skeleton can't be mirrored
+    int MirrorAxis = InvalidIndex;
 };
 
 //------------------------------------------------------------------------------
@@ -214,6 +270,14 @@ struct AnimInstanceSetup {
     Id Library;
     /// an optional AnimSkeleton if this is an instance
     Id Skeleton;
+    /// also output per-second velocities of all samples (float eval mode only)
+    bool Velocities = false;
+    /// optional leader instance, the instance then plays the leader's anim jobs instead of its own,
+    /// without time offset it also shares the leader's outputs if added to a frame after the leader
+    /// (the leader must use the same library, otherwise it is ignored with a warning)
+    Id Leader;
+    /// time offset in seconds by which the instance lags behind its leader
+    float LeaderTimeOffset = 0.0f;
 };
 
 //------------------------------------------------------------------------------
@@ -233,6 +297,10 @@ struct AnimCurve {
     float StaticValue[4];
     /// the key magnitude (for unpacking keys)
     float Magnitude[4];
+    /// the static value as Q16.16 fixed-point (only set in AnimEvalMode::FixedPoint)
+    int32_t FixedStaticValue[4];
+    /// the key magnitude as Q0.31 fixed-point (only set in AnimEvalMode::FixedPoint)
+    int32_t FixedMagnitude[4];
     /// stride in key elements (according to format)
     int KeyStride = 0;
     /// index of the first key in key pool (relative to clip)
@@ -258,6 +326,52 @@ struct AnimClip {
     Slice<AnimCurve> Curves;
     /// access to the clip's 2D key table
     Slice<int16_t> Keys;
+    /// index into AnimLibrary::RootMotion, or InvalidIndex if no root motion
+    int RootMotionIndex = InvalidIndex;
+    /// index into AnimLibrary::StaticBones, or InvalidIndex if clip has no static bones
+    int StaticBoneIndex = InvalidIndex;
+    /// decaying counter of how often the clip was evaluated
+    int PlayCount = 0;
+    /// pre-decoded float keys if the clip is 'hot' (Length * KeyStride floats), or nullptr
+    const float* HotKeys = nullptr;
+    /// pre-scaled (value, delta to next key) pairs (Length * KeyStride * 2 floats), or nullptr
+    const float* DeltaKeys = nullptr;
+    /// number of reduced-rate LODs of the clip
+    int NumLods = 0;
+    /// key tables of the reduced-rate LODs (LOD n at index n-1, ceil(Length / (1<<n)) * KeyStride keys)
+    const int16_t* LodKeys[AnimConfig::MaxNumClipLods] = { };
+    /// index into AnimLibrary::BakedClips, or InvalidIndex if the clip has no baked skin matrices
+    int BakedIndex = InvalidIndex;
+    /// number of pose basis coefficients per key (0 if the clip uses int16 keys)
+    int PoseBasisSize = 0;
+    /// the library's pose mean and basis vectors, or nullptr
+    const float* PoseBasis = nullptr;
+    /// pose basis coefficients (Length * PoseBasisSize floats), or nullptr
+    const float* PoseCoeffs = nullptr;
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimBakedClip
+    @ingroup Anim
+    @brief per-key skin matrices of a clip baked for one skeleton
+
+    The matrices are stored in the same transposed 4x3 layout as
+    in the skin matrix table, each element is quantized to 16 bits
+    with a per-bone, per-element offset and scale, and decoded as
+    Offset + Key * Scale.
+*/
+struct AnimBakedClip {
+    /// the skeleton the skin matrices have been baked for
+    Id Skeleton;
+    /// number of bones in the skeleton
+    int NumBones = 0;
+    /// quantized skin matrices (clip Length * NumBones * 12 keys)
+    Array<int16_t> Keys;
+    /// per bone and matrix element: decode offset
+    Array<float> Offset;
+    /// per bone and matrix element: decode scale
+    Array<float> Scale;
 };
 
 //------------------------------------------------------------------------------
@@ -271,9 +385,9 @@ struct AnimLibrary : public ResourceBase {
     class Locator Locator;
     /// stride of per-instance samples in number of floats
     int SampleStride = 0;
-    /// access to all clips in the library
+    /// access to all clips in the library (block in the clip pool, doesn't move until the library is destroyed)
     Slice<AnimClip> Clips;
-    /// array view over all curves of all clips
+    /// array view over all curves of all clips (block in the curve pool, doesn't move until the library is destroyed)
     Slice<AnimCurve> Curves;
     /// array view over all keys of all clips
     Slice<int16_t> Keys;
@@ -281,6 +395,34 @@ struct AnimLibrary : public ResourceBase {
     Map<StringAtom, int> ClipIndexMap;
     /// the curve layout (all clips in the library have the same layout)
     InlineArray<AnimCurveFormat::Enum, AnimConfig::MaxNumCurvesInClip> CurveLayout;
+    /// index of the root motion curve (or InvalidIndex)
+    int RootMotionCurve = InvalidIndex;
+    /// index of the root motion curve's first value in the samples
+    int RootMotionSampleIndex = InvalidIndex;
+    /// root motion extraction mask
+    glm::vec4 RootMotionMask;
+    /// per clip: first key value of root curve, followed by Length+1 accumulated displacements
+    Array<glm::vec4> RootMotion;
+    /// same as RootMotion as Q16.16, 4 values per entry (only in AnimEvalMode::FixedPoint)
+    Array<int32_t> FixedRootMotion;
+    /// number of bones if curve layout is (translate, rotate, scale) per bone, otherwise 0
+    int NumBones = 0;
+    /// per clip and bone: 1 if all curves of a bone are static, otherwise 0
+    Array<uint8_t> StaticBones;
+    /// per clip and bone: precomputed local bone matrix (only valid if bone is static)
+    Array<glm::mat4x3> StaticBoneMatrices;
+    /// storage for the (value, delta) key pairs of clips with AnimClipSetup::DeltaKeys
+    Array<float> DeltaKeys;
+    /// storage for the reduced-rate keys of clips with AnimClipSetup::NumLods
+    Array<int16_t> LodKeys;
+    /// baked skin matrices (see Anim::BakeSkinMatrices)
+    Array<AnimBakedClip> BakedClips;
+    /// number of pose basis vectors (0 if the library uses int16 keys)
+    int PoseBasisSize = 0;
+    /// pose mean followed by PoseBasisSize basis vectors (SampleStride floats each)
+    Array<float> PoseBasis;
+    /// pose basis coefficients of all clips (replace the int16 keys once written)
+    Array<float> PoseCoeffs;
 
     /// clear the object
     void clear() {
@@ -290,6 +432,20 @@ struct AnimLibrary : public ResourceBase {
         Curves.Reset();
         Keys.Reset();
         ClipIndexMap.Clear();
+        CurveLayout.Clear();
+        RootMotionCurve = InvalidIndex;
+        RootMotionSampleIndex = InvalidIndex;
+        RootMotion.Clear();
+        FixedRootMotion.Clear();
+        NumBones = 0;
+        StaticBones.Clear();
+        StaticBoneMatrices.Clear();
+        DeltaKeys.Clear();
+        LodKeys.Clear();
+        BakedClips.Clear();
+        PoseBasisSize = 0;
+        PoseBasis.Clear();
+        PoseCoeffs.Clear();
     };
 };
 
@@ -310,8 +466,14 @@ struct AnimSkeleton : public ResourceBase {
     Slice<glm::mat4x3> InvBindPose;
     /// this is the range of all matrices (BindPose and InvBindPose)
     Slice<glm::mat4x3> Matrices;
+    /// the inverse bind pose as Q16.16, 12 values per bone (only in AnimEvalMode::FixedPoint)
+    Array<int32_t> FixedInvBindPose;
     /// the parent bone indices (-1 if a root bone)
     StaticArray<int32_t, AnimConfig::MaxNumSkeletonBones> ParentIndices;
+    /// axis of the mirror plane normal, InvalidIndex if no mirror map
+    int MirrorAxis = InvalidIndex;
+    /// the mirrored bone indices (the bone itself if it mirrors itself)
+    StaticArray<int32_t, AnimConfig::MaxNumSkeletonBones> MirrorIndices;
 
     /// clear the object
     void clear() {
@@ -320,6 +482,8 @@ struct AnimSkeleton : public ResourceBase {
         BindPose.Reset();
         InvBindPose.Reset();
         Matrices.Reset();
+        FixedInvBindPose.Clear();
+        MirrorAxis = InvalidIndex;
     };
 };
 
@@ -343,7 +507,7 @@ struct AnimJob {
     int ClipIndex = 0;
     /// the track index for priority blending (higher tracks have higher priority)
     int TrackIndex = 0;
-    /// overall weight when mixing with lower-priority track
+    /// overall weight when mixing with lower-priority track (clamped to 0..1)
     float MixWeight = 1.0f; 
     /// start time relative to 'now' in seconds
     float StartTime = 0.0f;
@@ -355,6 +519,8 @@ struct AnimJob {
     float FadeIn = 0.0f;
     /// fade-out duration in seconds
     float FadeOut = 0.0f;
+    /// play the clip mirrored (needs a skeleton with mirror map, and a per-bone curve layout)
+    bool Mirror = false;
 };
 
 //------------------------------------------------------------------------------
@@ -377,9 +543,17 @@ struct AnimSkinMatrixInfo {
     struct InstanceInfo {
         Id Instance;
         glm::vec4 ShaderInfo;   // x: u texcoord, y: v texcoord, z: 1.0/texwidth
+        bool Dirty = true;      // false if the skin matrices are unchanged from last frame
     };
-    /// one entry per active anim instance
+    /// one entry per active anim instance with a skeleton (except for caller-owned skin matrices, see Anim::IsDirty)
     Array<InstanceInfo> InstanceInfos;
+    /// a byte range in the skin matrix table
+    struct Range {
+        int Offset = 0;
+        int Size = 0;
+    };
+    /// merged byte ranges of dirty skin matrices in the skin matrix table
+    Array<Range> DirtyRanges;
 };
 
 } // namespace Oryol
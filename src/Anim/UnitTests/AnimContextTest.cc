@@ -0,0 +1,88 @@
+//------------------------------------------------------------------------------
+//  AnimContextTest.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "UnitTest++/src/UnitTest++.h"
+#include "Anim/Anim.h"
+#if ORYOL_HAS_THREADS
+#include <thread>
+#endif
+
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+static Id
+createContextLibrary(const char* name, int length) {
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = Locator(name);
+    libSetup.CurveLayout.Add(AnimCurveFormat::Float3);
+    AnimClipSetup clipSetup;
+    clipSetup.Name = "clip";
+    clipSetup.Length = length;
+    clipSetup.KeyDuration = 0.04f;
+    clipSetup.Curves.Add(AnimCurveSetup(false, 0.0f, 0.0f, 0.0f, 0.0f));
+    libSetup.Clips.Add(clipSetup);
+    return Anim::Create(libSetup);
+}
+
+TEST(AnimContextTest) {
+
+    Anim::Setup();
+    AnimContext* defaultContext = Anim::DefaultContext();
+    CHECK(nullptr != defaultContext);
+    CHECK(Anim::CurrentContext() == defaultContext);
+    Id defaultLibId = createContextLibrary("lib", 10);
+    Id defaultInstId = Anim::Create(AnimInstanceSetup::FromLibrary(defaultLibId));
+    CHECK(Anim::Library(defaultLibId).Clips[0].Length == 10);
+
+    // a context has its own libraries, instances and time
+    AnimContext* context = Anim::CreateContext();
+    CHECK(context && (context != defaultContext));
+    Anim::MakeCurrentContext(context);
+    CHECK(Anim::CurrentContext() == context);
+    CHECK(Anim::DefaultContext() == defaultContext);
+    CHECK(!Anim::Lookup(Locator("lib")).IsValid());
+    Id libId = createContextLibrary("lib", 20);
+    CHECK(Anim::Library(libId).Clips[0].Length == 20);
+    CHECK(Anim::ClipIndex(libId, "clip") == 0);
+    CHECK(Anim::ClipIndex(libId, "walk") == InvalidIndex);
+    Id instId = Anim::Create(AnimInstanceSetup::FromLibrary(libId));
+    CHECK(Anim::Lookup(Locator("lib")) == libId);
+    Anim::NewFrame();
+    CHECK(Anim::AddActiveInstance(instId));
+    Anim::Evaluate(0.5);
+    CHECK(Anim::CurrentTime() == 0.5);
+
+    // the current context is per thread, other threads use the default context
+    #if ORYOL_HAS_THREADS
+    AnimContext* threadContext = nullptr;
+    double threadTime = -1.0;
+    std::thread thread([&threadContext, &threadTime] {
+        threadContext = Anim::CurrentContext();
+        threadTime = Anim::CurrentTime();
+    });
+    thread.join();
+    CHECK(threadContext == defaultContext);
+    CHECK(threadTime == 0.0);
+    #endif
+
+    // switching back to the default context
+    Anim::MakeCurrentContext(nullptr);
+    CHECK(Anim::CurrentContext() == defaultContext);
+    CHECK(Anim::CurrentTime() == 0.0);
+    CHECK(Anim::Lookup(Locator("lib")) == defaultLibId);
+    CHECK(Anim::Library(defaultLibId).Clips[0].Length == 10);
+    CHECK(Anim::instance(defaultInstId).library == &Anim::Library(defaultLibId));
+    Anim::MakeCurrentContext(context);
+    CHECK(Anim::Library(libId).Clips[0].Length == 20);
+    CHECK(Anim::instance(instId).library == &Anim::Library(libId));
+
+    // destroying the current context falls back to the default context
+    Anim::DestroyContext(context);
+    CHECK(Anim::CurrentContext() == defaultContext);
+    CHECK(Anim::Lookup(Locator("lib")) == defaultLibId);
+    CHECK(Anim::Library(defaultLibId).Clips[0].Length == 10);
+    Anim::Discard();
+    CHECK(!Anim::IsValid());
+    CHECK(nullptr == Anim::DefaultContext());
+}
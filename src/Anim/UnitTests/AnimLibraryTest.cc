@@ -5,10 +5,74 @@
 #include "UnitTest++/src/UnitTest++.h"
 #include "Anim/AnimTypes.h"
 #include "Anim/private/animMgr.h"
+#include "Anim/private/animFixed.h"
+#include <string.h>
 
 using namespace Oryol;
 using namespace _priv;
 
+//------------------------------------------------------------------------------
+static AnimLibrarySetup
+testLibrarySetup(const char* name, int numBones, int length) {
+    // each bone has a translation, rotation and scale curve, clip 'walk'
+    // has animated translations and rotations, clip 'idle' is all static
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = Locator::NonShared(name);
+    for (int i = 0; i < numBones; i++) {
+        libSetup.CurveLayout.Add(AnimCurveFormat::Float3);
+        libSetup.CurveLayout.Add(AnimCurveFormat::Float4);
+        libSetup.CurveLayout.Add(AnimCurveFormat::Float3);
+    }
+    for (int clipIndex = 0; clipIndex < 2; clipIndex++) {
+        const bool isStatic = (1 == clipIndex);
+        AnimClipSetup clipSetup;
+        clipSetup.Name = isStatic ? "idle" : "walk";
+        clipSetup.Length = length;
+        clipSetup.KeyDuration = 0.04f;
+        for (int i = 0; i < numBones; i++) {
+            AnimCurveSetup t(isStatic, 0.1f * i, 0.0f, 0.0f, 0.0f);
+            t.Magnitude = glm::vec4(2.0f);
+            AnimCurveSetup r(isStatic, 0.0f, 0.0f, 0.0f, 1.0f);
+            AnimCurveSetup s(true, 1.0f, 1.0f, 1.0f, 0.0f);
+            clipSetup.Curves.Add(t);
+            clipSetup.Curves.Add(r);
+            clipSetup.Curves.Add(s);
+        }
+        libSetup.Clips.Add(clipSetup);
+    }
+    return libSetup;
+}
+
+//------------------------------------------------------------------------------
+static void
+writeTestKeys(animMgr& mgr, AnimLibrary* lib, int seed) {
+    Array<int16_t> keys;
+    keys.Reserve(lib->Keys.Size());
+    for (int i = 0; i < lib->Keys.Size(); i++) {
+        keys.Add(int16_t(((i + seed) * 7919) % 20000 - 10000));
+    }
+    mgr.writeKeys(lib, (const uint8_t*) keys.begin(), keys.Size() * int(sizeof(int16_t)));
+}
+
+//------------------------------------------------------------------------------
+static Id
+createTestLibrary(animMgr& mgr, const char* name, int numBones, int length) {
+    Id libId = mgr.createLibrary(testLibrarySetup(name, numBones, length));
+    writeTestKeys(mgr, mgr.lookupLibrary(libId), 0);
+    return libId;
+}
+
+//------------------------------------------------------------------------------
+static Id
+createTestSkeleton(animMgr& mgr, const char* name, int numBones) {
+    AnimSkeletonSetup skelSetup;
+    skelSetup.Locator = Locator::NonShared(name);
+    for (int i = 0; i < numBones; i++) {
+        skelSetup.Bones.Add(AnimBoneSetup("bone", i - 1, glm::mat4(), glm::mat4()));
+    }
+    return mgr.createSkeleton(skelSetup);
+}
+
 TEST(AnimLibraryTest) {
 
     // setup
@@ -145,6 +209,9 @@ TEST(AnimLibraryTest) {
     CHECK(lib2Ptr->SampleStride == 9);
     CHECK(lib2Ptr->Clips.Size() == 2);
     CHECK(lib2Ptr->Clips[0].Name == "clip1");
+    CHECK(lib2Ptr->Clips.Offset() == 2);
+    CHECK(lib2Ptr->ClipIndexMap.Contains("clip1") && (lib2Ptr->ClipIndexMap["clip1"] == 0));
+    CHECK(lib2Ptr->ClipIndexMap.Contains("clip2") && (lib2Ptr->ClipIndexMap["clip2"] == 1));
     CHECK(lib2Ptr->Clips[0].Length == 10);
     CHECK(lib2Ptr->Clips[0].KeyStride == 5);
     CHECK(lib2Ptr->Clips[0].Keys.Size() == 50);
@@ -208,9 +275,25 @@ TEST(AnimLibraryTest) {
     CHECK_CLOSE(lib2Ptr->Clips[1].Curves[2].StaticValue[3], 9.0f, 0.001f);
     mgr.destroy(l1);
     CHECK(mgr.libPool.QueryPoolInfo().NumUsedSlots == 1);
-    CHECK(mgr.clipPool.Size() == 2);
-    CHECK(mgr.curvePool.Size() == 6);
+    CHECK(mgr.clipBlocks.numAllocated() == 2);
+    CHECK(mgr.curveBlocks.numAllocated() == 6);
     CHECK(mgr.numKeys == 110);
+    // clips and curves of the remaining library don't move, only the keys
+    CHECK(lib2Ptr->Clips[0].Curves.Offset() == 6);
+    CHECK(lib2Ptr->Clips[1].Curves.Offset() == 9);
+    CHECK(lib2Ptr->Clips[0].Keys.Offset() == 0);
+    CHECK(lib2Ptr->Clips[1].Keys.Offset() == 50);
+
+    // a new library reuses the free clip and curve blocks
+    libSetup.Locator = "human";
+    Id lib3 = mgr.createLibrary(libSetup);
+    CHECK(lib3.IsValid());
+    const AnimLibrary* lib3Ptr = mgr.lookupLibrary(lib3);
+    CHECK(lib3Ptr->Clips[0].Curves.Offset() == 0);
+    CHECK(lib3Ptr->Clips[1].Curves.Offset() == 3);
+    CHECK(lib3Ptr->Clips[0].Keys.Offset() == 110);
+    CHECK(mgr.clipPool.Size() == 4);
+    CHECK(mgr.curvePool.Size() == 12);
 
     mgr.discard();
     CHECK(!mgr.isValid);
@@ -218,3 +301,1221 @@ TEST(AnimLibraryTest) {
     CHECK(mgr.curvePool.Size() == 0);
     CHECK(mgr.numKeys == 0);
 }
+
+TEST(AnimFixedPointTest) {
+
+    // two managers evaluating the same jobs must produce bit-identical
+    // samples and skin matrices in fixed-point mode
+    AnimSetup setup;
+    setup.EvalMode = AnimEvalMode::FixedPoint;
+    animMgr mgr[2];
+    animInstance* inst[2];
+    for (int i = 0; i < 2; i++) {
+        mgr[i].setup(setup);
+        Id libId = createTestLibrary(mgr[i], "lib", 4, 10);
+        Id skelId = createTestSkeleton(mgr[i], "skel", 4);
+        inst[i] = mgr[i].lookupInstance(mgr[i].createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId)));
+        AnimJob job;
+        mgr[i].play(inst[i], job);
+        job.ClipIndex = 1;
+        job.TrackIndex = 1;
+        job.MixWeight = 0.5f;
+        job.FadeIn = 0.2f;
+        mgr[i].play(inst[i], job);
+    }
+    for (int frame = 0; frame < 20; frame++) {
+        for (int i = 0; i < 2; i++) {
+            mgr[i].newFrame();
+            CHECK(mgr[i].addActiveInstance(inst[i]));
+            mgr[i].evaluate(1.0 / 60.0);
+        }
+        CHECK(inst[0]->fixedSamples.Size() == inst[0]->samples.Size());
+        CHECK(0 == memcmp(inst[0]->fixedSamples.begin(), inst[1]->fixedSamples.begin(), inst[0]->fixedSamples.Size() * sizeof(int32_t)));
+        CHECK(0 == memcmp(inst[0]->samples.begin(), inst[1]->samples.begin(), inst[0]->samples.Size() * sizeof(float)));
+        CHECK(0 == memcmp(inst[0]->skinMatrices.begin(), inst[1]->skinMatrices.begin(), inst[0]->skinMatrices.Size() * sizeof(float)));
+        // the float samples are converted from the fixed-point samples
+        for (int i = 0; i < inst[0]->samples.Size(); i++) {
+            CHECK(inst[0]->samples[i] == animFixed::toFloat(inst[0]->fixedSamples[i]));
+        }
+    }
+    // the static scale curves are exactly their fixed-point static value
+    const AnimCurve& scaleCurve = inst[0]->library->Clips[0].Curves[2];
+    CHECK(inst[0]->fixedSamples[7] == scaleCurve.FixedStaticValue[0]);
+    CHECK(inst[0]->fixedSamples[7] == animFixed::One);
+
+    // out-of-range magnitudes are clamped instead of overflowing
+    AnimLibrarySetup libSetup = testLibrarySetup("big", 1, 4);
+    libSetup.Clips[0].Curves[0].Magnitude = glm::vec4(40000.0f);
+    const AnimLibrary* lib = mgr[0].lookupLibrary(mgr[0].createLibrary(libSetup));
+    CHECK(lib->Clips[0].Curves[0].FixedMagnitude[0] == animFixed::fromMagnitude(animFixed::clampMagnitude(2.0f)));
+    CHECK(lib->Clips[0].Curves[0].FixedMagnitude[0] > 0);
+
+    for (int i = 0; i < 2; i++) {
+        mgr[i].discard();
+    }
+}
+
+TEST(AnimFixedPointFloatTest) {
+
+    // fixed-point and float evaluation agree within the fixed-point
+    // precision, also for mix weights outside 0..1 (which are clamped),
+    // and with an inverse bind pose which isn't the identity
+    const float delta = 0.005f;
+    animMgr mgr[2];
+    animInstance* inst[2];
+    for (int i = 0; i < 2; i++) {
+        AnimSetup setup;
+        setup.EvalMode = (0 == i) ? AnimEvalMode::Float : AnimEvalMode::FixedPoint;
+        mgr[i].setup(setup);
+        Id libId = createTestLibrary(mgr[i], "lib", 2, 10);
+        AnimSkeletonSetup skelSetup;
+        skelSetup.Locator = Locator::NonShared("skel");
+        glm::mat4 invBindPose;
+        invBindPose[3] = glm::vec4(0.5f, -0.25f, 1.0f, 1.0f);
+        skelSetup.Bones.Add(AnimBoneSetup("root", -1, glm::mat4(), invBindPose));
+        skelSetup.Bones.Add(AnimBoneSetup("child", 0, glm::mat4(), invBindPose));
+        Id skelId = mgr[i].createSkeleton(skelSetup);
+        inst[i] = mgr[i].lookupInstance(mgr[i].createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId)));
+        AnimJob job;
+        job.MixWeight = 1.5f;
+        mgr[i].play(inst[i], job);
+        job.TrackIndex = 1;
+        job.StartTime = 0.05f;
+        job.MixWeight = 2.0f;
+        job.FadeIn = 0.1f;
+        mgr[i].play(inst[i], job);
+    }
+    CHECK(inst[0]->skeleton->FixedInvBindPose.Empty());
+    const AnimSkeleton* skel = inst[1]->skeleton;
+    CHECK(skel->FixedInvBindPose.Size() == skel->NumBones * 12);
+    for (int i = 0; i < skel->FixedInvBindPose.Size(); i++) {
+        CHECK(skel->FixedInvBindPose[i] == animFixed::fromFloat((&skel->InvBindPose[0][0][0])[i]));
+    }
+    for (int frame = 0; frame < 12; frame++) {
+        for (int i = 0; i < 2; i++) {
+            mgr[i].newFrame();
+            CHECK(mgr[i].addActiveInstance(inst[i]));
+            mgr[i].evaluate(1.0 / 60.0);
+        }
+        for (int i = 0; i < inst[0]->samples.Size(); i++) {
+            CHECK_CLOSE(inst[0]->samples[i], inst[1]->samples[i], delta);
+        }
+        for (int i = 0; i < inst[0]->skinMatrices.Size(); i++) {
+            CHECK_CLOSE(inst[0]->skinMatrices[i], inst[1]->skinMatrices[i], delta);
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        mgr[i].discard();
+    }
+}
+
+TEST(AnimDecodeStateTest) {
+
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    Id libId = createTestLibrary(mgr, "lib", 2, 10);
+    animInstance* src = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibrary(libId)));
+    animInstance* dst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibrary(libId)));
+    AnimJob job;
+    job.ClipIndex = 1;
+    const AnimJobId jobId = mgr.play(src, job);
+    uint8_t state[animSequencer::maxEncodedBytes];
+    int numBytes = mgr.encodeState(src, state, sizeof(state), nullptr, 0);
+    CHECK(numBytes > 0);
+    CHECK(mgr.decodeState(dst, state, numBytes, nullptr, 0));
+    CHECK(dst->sequencer.items.Size() == 1);
+    CHECK(dst->sequencer.items[0].id == jobId);
+
+    // a clip index the library doesn't have is rejected, the jobs are unchanged
+    src->sequencer.items[0].clipIndex = 2;
+    numBytes = mgr.encodeState(src, state, sizeof(state), nullptr, 0);
+    CHECK(numBytes > 0);
+    CHECK(!mgr.decodeState(dst, state, numBytes, nullptr, 0));
+    CHECK(dst->sequencer.items.Size() == 1);
+    CHECK(dst->sequencer.items[0].clipIndex == 1);
+
+    // new jobs don't reuse the ids of decoded jobs
+    src->sequencer.items[0].clipIndex = 0;
+    src->sequencer.items[0].id = jobId + 100;
+    numBytes = mgr.encodeState(src, state, sizeof(state), nullptr, 0);
+    CHECK(mgr.decodeState(dst, state, numBytes, nullptr, 0));
+    CHECK(mgr.play(dst, job) > jobId + 100);
+
+    mgr.discard();
+}
+
+TEST(AnimSampleClipTest) {
+
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    const AnimLibrary* lib = mgr.lookupLibrary(createTestLibrary(mgr, "lib", 4, 10));
+    const AnimClip& clip = lib->Clips[0];
+    const int stride = lib->SampleStride;
+
+    // sampling at a key time returns the key values exactly, even
+    // if the key time isn't exactly representable
+    for (int key = 0; key < clip.Length; key++) {
+        const double time = key * clip.KeyDuration;
+        float smp[AnimConfig::MaxNumCurvesInClip * 4];
+        mgr.sampleClip(lib, 0, &time, 1, smp);
+        const int16_t* row = &(clip.Keys[key * clip.KeyStride]);
+        CHECK(smp[0] == float(row[0]) * clip.Curves[0].Magnitude[0]);
+        CHECK(smp[3] == float(row[3]) * clip.Curves[1].Magnitude[0]);
+    }
+
+    // batched sampling on the worker threads matches single sampling
+    const int numTimes = 1000;
+    Array<double> times;
+    Array<float> batched;
+    for (int i = 0; i < numTimes; i++) {
+        times.Add(i * 0.013);
+    }
+    batched.Reserve(numTimes * stride);
+    for (int i = 0; i < (numTimes * stride); i++) {
+        batched.Add(0.0f);
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        mgr.sampleClip(lib, 0, times.begin(), numTimes, batched.begin());
+        for (int i = 0; i < numTimes; i += 37) {
+            float smp[AnimConfig::MaxNumCurvesInClip * 4];
+            mgr.sampleClip(lib, 0, &times[i], 1, smp);
+            CHECK(0 == memcmp(smp, &batched[i * stride], stride * sizeof(float)));
+        }
+    }
+
+    mgr.discard();
+}
+
+TEST(AnimRootMotionTest) {
+
+    // a clip with 5 keys of 0.1 seconds, the root moves 1.0 per key along x,
+    // the loop-aware displacement is 5.0 per loop (10.0 per second)
+    for (int mode = 0; mode < 2; mode++) {
+        AnimSetup setup;
+        setup.EvalMode = mode ? AnimEvalMode::FixedPoint : AnimEvalMode::Float;
+        animMgr mgr;
+        mgr.setup(setup);
+        AnimLibrarySetup libSetup;
+        libSetup.Locator = "root";
+        libSetup.CurveLayout = { AnimCurveFormat::Float3 };
+        libSetup.RootMotionCurve = 0;
+        AnimClipSetup clipSetup;
+        clipSetup.Name = "walk";
+        clipSetup.Length = 5;
+        clipSetup.KeyDuration = 0.1f;
+        AnimCurveSetup curveSetup(false, 0.0f, 0.0f, 0.0f, 0.0f);
+        curveSetup.Magnitude = glm::vec4(32.767f);
+        clipSetup.Curves.Add(curveSetup);
+        libSetup.Clips.Add(clipSetup);
+        Id libId = mgr.createLibrary(libSetup);
+        int16_t keys[15];
+        for (int i = 0; i < 5; i++) {
+            keys[i*3 + 0] = int16_t(i * 1000);
+            keys[i*3 + 1] = 0;
+            keys[i*3 + 2] = 0;
+        }
+        mgr.writeKeys(mgr.lookupLibrary(libId), (const uint8_t*) keys, sizeof(keys));
+        animInstance* inst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibrary(libId)));
+        AnimJob job;
+        mgr.play(inst, job);
+
+        // evaluate() advances the time after evaluating, so the root
+        // motion of a frame covers the previous frame's duration
+        const double frameDurs[] = { 0.45, 0.1, 1.2, 0.05, 0.0 };
+        const float expected[] = { 0.0f, 4.5f, 1.0f, 12.0f, 0.5f };
+        for (int frame = 0; frame < 5; frame++) {
+            mgr.newFrame();
+            CHECK(mgr.addActiveInstance(inst));
+            mgr.evaluate(frameDurs[frame]);
+            // frame 2 crosses the loop boundary, frame 3 covers multiple loops
+            CHECK_CLOSE(inst->rootMotion.x, expected[frame], 0.001f);
+            CHECK_CLOSE(inst->rootMotion.y, 0.0f, 0.001f);
+            // the root motion is stripped from the samples
+            CHECK_CLOSE(inst->samples[0], 0.0f, 0.001f);
+            if (mode) {
+                CHECK(inst->fixedSamples[0] == 0);
+            }
+        }
+
+        // a job which ends in the middle of a frame still contributes its
+        // root motion until its end, also if a job is added in between
+        animInstance* endInst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibrary(libId)));
+        job.Duration = 0.25f;
+        mgr.play(endInst, job);
+        const float expectedEnd[] = { 0.0f, 1.0f, 1.0f, 0.5f, 0.0f };
+        for (int frame = 0; frame < 5; frame++) {
+            if (3 == frame) {
+                AnimJob futureJob;
+                futureJob.TrackIndex = 1;
+                futureJob.StartTime = 10.0f;
+                mgr.play(endInst, futureJob);
+            }
+            mgr.newFrame();
+            CHECK(mgr.addActiveInstance(endInst));
+            mgr.evaluate(0.1);
+            CHECK_CLOSE(endInst->rootMotion.x, expectedEnd[frame], 0.001f);
+        }
+        // the ended job is removed once its root motion is extracted
+        CHECK(endInst->sequencer.items.Size() == 1);
+        mgr.discard();
+    }
+}
+
+TEST(AnimSkipUnchangedTest) {
+
+    // an instance playing a clip without animated curves is only
+    // evaluated in the first frame, an animated one in every frame
+    AnimSetup setup;
+    setup.SkipUnchangedInstances = true;
+    animMgr mgr;
+    mgr.setup(setup);
+    Id libId = createTestLibrary(mgr, "lib", 2, 10);
+    Id skelId = createTestSkeleton(mgr, "skel", 2);
+    CHECK(mgr.lookupLibrary(libId)->Clips[1].KeyStride == 0);
+    animInstance* staticInst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId)));
+    animInstance* animInst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId)));
+    AnimJob job;
+    mgr.play(animInst, job);
+    job.ClipIndex = 1;
+    mgr.play(staticInst, job);
+    for (int frame = 0; frame < 3; frame++) {
+        mgr.newFrame();
+        CHECK(mgr.addActiveInstance(staticInst));
+        CHECK(mgr.addActiveInstance(animInst));
+        mgr.evaluate(1.0 / 60.0);
+        CHECK(staticInst->dirty == (0 == frame));
+        CHECK(animInst->dirty);
+        CHECK(mgr.skinMatrixInfo.InstanceInfos[0].Dirty == (0 == frame));
+    }
+    mgr.discard();
+}
+
+TEST(AnimClipLodTest) {
+
+    // LOD n keeps every (1<<n)-th key row, with a length of 10 keys the
+    // last segment of LOD 2 is only 2 keys long and wraps to the first key
+    const float delta = 0.0001f;
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    AnimLibrarySetup libSetup = testLibrarySetup("lib", 2, 10);
+    libSetup.Clips[0].NumLods = 2;
+    Id libId = mgr.createLibrary(libSetup);
+    AnimLibrary* lib = mgr.lookupLibrary(libId);
+    writeTestKeys(mgr, lib, 0);
+    const AnimClip& clip = lib->Clips[0];
+    CHECK(clip.NumLods == 2);
+    CHECK(lib->Clips[1].NumLods == 0);
+    for (int lod = 1; lod <= 2; lod++) {
+        const int step = 1 << lod;
+        const int lodLength = (clip.Length + step - 1) / step;
+        CHECK(lodLength == ((1 == lod) ? 5 : 3));
+        for (int lodKey = 0; lodKey < lodLength; lodKey++) {
+            const int16_t* lodRow = clip.LodKeys[lod - 1] + lodKey * clip.KeyStride;
+            const int16_t* row = &(clip.Keys[lodKey * step * clip.KeyStride]);
+            CHECK(0 == memcmp(lodRow, row, clip.KeyStride * sizeof(int16_t)));
+        }
+    }
+
+    // the full-rate samples at the original keys
+    const int numSamples = lib->SampleStride;
+    const double keyDur = clip.KeyDuration;
+    animInstance* inst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibrary(libId)));
+    AnimJob job;
+    mgr.play(inst, job);
+    float keySamples[10 * 20];
+    o_assert((clip.Length * numSamples) <= (10 * 20));
+    for (int key = 0; key < clip.Length; key++) {
+        CHECK(inst->sequencer.eval(lib, key * keyDur, keySamples + key * numSamples, numSamples));
+    }
+
+    // a LOD passes through the keys it keeps, and interpolates between them
+    float smp[20];
+    for (int key = 0; key < 8; key += 4) {
+        CHECK(inst->sequencer.eval(lib, key * keyDur, smp, numSamples, nullptr, nullptr, 2));
+        for (int i = 0; i < numSamples; i++) {
+            CHECK_CLOSE(keySamples[key * numSamples + i], smp[i], delta);
+        }
+        CHECK(inst->sequencer.eval(lib, (key + 2) * keyDur, smp, numSamples, nullptr, nullptr, 2));
+        for (int i = 0; i < numSamples; i++) {
+            const float v0 = keySamples[key * numSamples + i];
+            const float v1 = keySamples[(key + 4) * numSamples + i];
+            CHECK_CLOSE(v0 + (v1 - v0) * 0.5f, smp[i], delta);
+        }
+    }
+
+    // the shortened last segment goes from key 8 back to key 0 within 2 keys
+    CHECK(inst->sequencer.eval(lib, 9 * keyDur, smp, numSamples, nullptr, nullptr, 2));
+    for (int i = 0; i < numSamples; i++) {
+        const float v0 = keySamples[8 * numSamples + i];
+        const float v1 = keySamples[i];
+        CHECK_CLOSE(v0 + (v1 - v0) * 0.5f, smp[i], delta);
+    }
+    CHECK(inst->sequencer.eval(lib, 10 * keyDur, smp, numSamples, nullptr, nullptr, 2));
+    for (int i = 0; i < numSamples; i++) {
+        CHECK_CLOSE(keySamples[i], smp[i], delta);
+    }
+    mgr.discard();
+}
+
+TEST(AnimBakeSkinMatricesTest) {
+
+    // at key times, baked playback matches the regular evaluation
+    // within the 16-bit quantization error of each matrix element
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    AnimLibrarySetup libSetup = testLibrarySetup("lib", 3, 10);
+    libSetup.Clips[1].Length = 0;
+    Id libId = mgr.createLibrary(libSetup);
+    AnimLibrary* lib = mgr.lookupLibrary(libId);
+    writeTestKeys(mgr, lib, 0);
+    Id skelId = createTestSkeleton(mgr, "skel", 3);
+    AnimSkeleton* skel = mgr.lookupSkeleton(skelId);
+    CHECK(!mgr.bakeSkinMatrices(lib, 1, skel));
+    CHECK(lib->Clips[1].BakedIndex == InvalidIndex);
+    CHECK(mgr.bakeSkinMatrices(lib, 0, skel));
+    CHECK(lib->Clips[0].BakedIndex == 0);
+    const AnimBakedClip& baked = lib->BakedClips[0];
+    CHECK(baked.NumBones == 3);
+    CHECK(baked.Keys.Size() == (10 * 3 * 12));
+
+    animInstance* evalInst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId)));
+    animInstance* bakedInst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId)));
+    AnimJob job;
+    mgr.play(evalInst, job);
+    mgr.play(bakedInst, job);
+    bool anyQuantized = false;
+    for (int frame = 0; frame < 12; frame++) {
+        mgr.newFrame();
+        CHECK(mgr.addActiveInstance(evalInst));
+        CHECK(mgr.addActiveInstance(bakedInst, nullptr, nullptr, AnimConfig::BakedClipLod));
+        mgr.evaluate(lib->Clips[0].KeyDuration);
+        for (int i = 0; i < 3 * 12; i++) {
+            const float maxError = baked.Scale[i] + 0.0001f;
+            CHECK_CLOSE(evalInst->skinMatrices[i], bakedInst->skinMatrices[i], maxError);
+            anyQuantized |= evalInst->skinMatrices[i] != bakedInst->skinMatrices[i];
+        }
+    }
+    // the baked instance really went through the quantized matrices
+    CHECK(anyQuantized);
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+static void
+writeRank2Keys(animMgr& mgr, AnimLibrary* lib) {
+    // each key row is a combination of 2 fixed rows, so that a pose
+    // basis of size 2 can reconstruct the poses exactly
+    Array<int16_t> keys;
+    keys.Reserve(lib->Keys.Size());
+    const int keyStride = lib->Clips[0].KeyStride;
+    for (int i = 0; i < lib->Keys.Size(); i++) {
+        const int key = i / keyStride;
+        const int j = i % keyStride;
+        const int a = key % 3;
+        const int b = (key * 7) % 5;
+        keys.Add(int16_t(a * ((j % 4) * 3000 - 4000) + b * ((j % 3) * 1000 - 1000)));
+    }
+    mgr.writeKeys(lib, (const uint8_t*) keys.begin(), keys.Size() * int(sizeof(int16_t)));
+}
+
+TEST(AnimPoseBasisTest) {
+
+    // the pose basis library sits between 2 regular libraries, releasing
+    // its keys moves the keys of the library behind it, LODs of its
+    // clips are ignored
+    const float delta = 0.001f;
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    AnimLibrarySetup libSetup = testLibrarySetup("ref", 2, 10);
+    libSetup.Clips[1].Length = 0;
+    Id refId = mgr.createLibrary(libSetup);
+    libSetup.Locator = Locator::NonShared("basis");
+    libSetup.PoseBasisSize = 2;
+    libSetup.Clips[0].NumLods = 1;
+    Id basisId = mgr.createLibrary(libSetup);
+    Id otherId = mgr.createLibrary(testLibrarySetup("other", 2, 10));
+    AnimLibrary* ref = mgr.lookupLibrary(refId);
+    AnimLibrary* basis = mgr.lookupLibrary(basisId);
+    AnimLibrary* other = mgr.lookupLibrary(otherId);
+    writeRank2Keys(mgr, ref);
+    writeTestKeys(mgr, other, 0);
+    const int numRefKeys = ref->Keys.Size();
+    const int numOtherKeys = other->Keys.Size();
+    CHECK(mgr.numKeys == (2 * numRefKeys + numOtherKeys));
+    CHECK(other->Keys.Offset() == (2 * numRefKeys));
+    const int numSamples = ref->SampleStride;
+    const double clipDuration = 10 * ref->Clips[0].KeyDuration;
+    float otherBefore[5 * 20];
+    o_assert(numSamples <= 20);
+    for (int i = 0; i < 5; i++) {
+        animSequencer::sampleCached(other->Clips[0], clipDuration * i / 5.0, otherBefore + i * numSamples, nullptr);
+    }
+
+    // the int16 keys are released from the key pool
+    writeRank2Keys(mgr, basis);
+    CHECK(basis->PoseBasisSize == 2);
+    CHECK(basis->Keys.Empty());
+    CHECK(basis->Clips[0].Keys.Empty());
+    CHECK(basis->Clips[0].PoseCoeffs != nullptr);
+    CHECK(basis->PoseBasis.Size() == (3 * numSamples));
+    CHECK(basis->PoseCoeffs.Size() == (10 * 2));
+    CHECK(0 == basis->Clips[0].NumLods);
+    CHECK(basis->LodKeys.Empty());
+    CHECK(mgr.numKeys == (numRefKeys + numOtherKeys));
+    CHECK(other->Keys.Offset() == numRefKeys);
+    float smp[20];
+    for (int i = 0; i < 5; i++) {
+        animSequencer::sampleCached(other->Clips[0], clipDuration * i / 5.0, smp, nullptr);
+        CHECK(0 == memcmp(otherBefore + i * numSamples, smp, numSamples * sizeof(float)));
+    }
+
+    // poses reconstructed from the basis match the regular samples, on and between keys
+    float refSmp[20];
+    for (int i = 0; i < 25; i++) {
+        const double t = clipDuration * i / 25.0;
+        animSequencer::sampleCached(ref->Clips[0], t, refSmp, nullptr);
+        animSequencer::sampleCached(basis->Clips[0], t, smp, nullptr);
+        for (int j = 0; j < numSamples; j++) {
+            CHECK_CLOSE(refSmp[j], smp[j], delta);
+        }
+    }
+
+    // instances with a LOD sample the basis at full rate
+    animInstance* inst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibrary(basisId)));
+    AnimJob job;
+    mgr.play(inst, job);
+    float lodSmp[20];
+    CHECK(inst->sequencer.eval(basis, 0.1, smp, numSamples));
+    CHECK(inst->sequencer.eval(basis, 0.1, lodSmp, numSamples, nullptr, nullptr, 1));
+    CHECK(0 == memcmp(smp, lodSmp, numSamples * sizeof(float)));
+    mgr.discard();
+}
+
+TEST(AnimLeaderTest) {
+
+    // a follower without time offset which is added after its leader
+    // shares the leader's outputs, otherwise it is evaluated on its own
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    Id libId = createTestLibrary(mgr, "lib", 2, 10);
+    Id skelId = createTestSkeleton(mgr, "skel", 2);
+    Id leaderId = mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId));
+    animInstance* leader = mgr.lookupInstance(leaderId);
+    AnimInstanceSetup followerSetup = AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId);
+    followerSetup.Leader = leaderId;
+    animInstance* follower = mgr.lookupInstance(mgr.createInstance(followerSetup));
+    AnimJob job;
+    mgr.play(leader, job);
+    mgr.newFrame();
+    CHECK(mgr.addActiveInstance(leader));
+    CHECK(mgr.addActiveInstance(follower));
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(follower->sharedLeader == leader);
+    CHECK(follower->samples.begin() == leader->samples.begin());
+    CHECK(follower->skinMatrices.begin() == leader->skinMatrices.begin());
+    CHECK(mgr.skinMatrixInfo.InstanceInfos.Size() == 2);
+    CHECK(mgr.skinMatrixInfo.InstanceInfos[1].ShaderInfo == mgr.skinMatrixInfo.InstanceInfos[0].ShaderInfo);
+    mgr.newFrame();
+    CHECK(mgr.addActiveInstance(follower));
+    CHECK(mgr.addActiveInstance(leader));
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(nullptr == follower->sharedLeader);
+    CHECK(follower->samples.begin() != leader->samples.begin());
+    CHECK(0 == memcmp(follower->samples.begin(), leader->samples.begin(), leader->samples.Size() * sizeof(float)));
+    mgr.discard();
+}
+
+TEST(AnimLeaderOffsetTest) {
+
+    // a follower which lags behind its leader keeps playing a one-shot
+    // job after the leader has finished and garbage-collected it
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    Id libId = createTestLibrary(mgr, "lib", 2, 10);
+    Id leaderId = mgr.createInstance(AnimInstanceSetup::FromLibrary(libId));
+    animInstance* leader = mgr.lookupInstance(leaderId);
+    AnimInstanceSetup followerSetup = AnimInstanceSetup::FromLibrary(libId);
+    followerSetup.Leader = leaderId;
+    followerSetup.LeaderTimeOffset = 0.2f;
+    animInstance* follower = mgr.lookupInstance(mgr.createInstance(followerSetup));
+    animInstance* ref = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibrary(libId)));
+    AnimJob job;
+    job.Duration = 0.4f;
+    mgr.play(leader, job);
+    job.StartTime = 0.2f;
+    mgr.play(ref, job);
+    bool leaderDone = false;
+    for (int frame = 0; frame < 40; frame++) {
+        mgr.newFrame();
+        CHECK(mgr.addActiveInstance(leader));
+        CHECK(mgr.addActiveInstance(follower));
+        CHECK(mgr.addActiveInstance(ref));
+        mgr.evaluate(0.02);
+        CHECK(follower->sequencer.items.Size() == ref->sequencer.items.Size());
+        if ((frame >= 12) && (frame <= 28)) {
+            // both play the job
+            CHECK(0 == memcmp(follower->samples.begin(), ref->samples.begin(), ref->samples.Size() * sizeof(float)));
+            leaderDone |= leader->sequencer.items.Empty();
+        }
+    }
+    CHECK(leaderDone);
+    CHECK(follower->sequencer.items.Empty());
+    mgr.discard();
+}
+
+TEST(AnimCloneInstanceTest) {
+
+    // clones start with the source's shared resources, anim jobs and
+    // leader settings, and evaluate to the same outputs as the source
+    AnimSetup setup;
+    setup.MaxNumInstances = 4;
+    animMgr mgr;
+    mgr.setup(setup);
+    Id libId = createTestLibrary(mgr, "lib", 2, 10);
+    Id skelId = createTestSkeleton(mgr, "skel", 2);
+    AnimInstanceSetup instSetup = AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId);
+    instSetup.Velocities = true;
+    instSetup.LeaderTimeOffset = 0.5f;
+    animInstance* src = mgr.lookupInstance(mgr.createInstance(instSetup));
+    AnimJob job;
+    job.Duration = 2.0f;
+    mgr.play(src, job);
+    job.ClipIndex = 1;
+    job.TrackIndex = 1;
+    job.StartTime = 0.1f;
+    job.MixWeight = 0.5f;
+    mgr.play(src, job);
+    mgr.newFrame();
+    CHECK(mgr.addActiveInstance(src));
+    mgr.evaluate(0.25);
+
+    // only 3 instance slots are left
+    ResourceLabel label = mgr.resContainer.PushLabel();
+    Id cloneIds[4];
+    CHECK(mgr.cloneInstances(src, 4, cloneIds) == 3);
+    mgr.resContainer.PopLabel();
+    animInstance* clones[3];
+    for (int i = 0; i < 3; i++) {
+        clones[i] = mgr.lookupInstance(cloneIds[i]);
+        const animInstance* clone = clones[i];
+        CHECK(clone && (clone != src));
+        CHECK(clone->library == src->library);
+        CHECK(clone->skeleton == src->skeleton);
+        CHECK(clone->hasVelocities);
+        CHECK(clone->sequencer.mirrorSkeleton == src->sequencer.mirrorSkeleton);
+        CHECK(!clone->leaderId.IsValid());
+        CHECK(clone->leaderTimeOffset == src->leaderTimeOffset);
+        CHECK(clone->sequencer.items.Size() == 2);
+        CHECK(clone->sequencer.items.Size() == src->sequencer.items.Size());
+        for (int j = 0; j < src->sequencer.items.Size(); j++) {
+            const animSequencer::item& a = src->sequencer.items[j];
+            const animSequencer::item& b = clone->sequencer.items[j];
+            CHECK((a.id == b.id) && (a.valid == b.valid) && (a.clipIndex == b.clipIndex) && (a.trackIndex == b.trackIndex));
+            CHECK((a.mixWeight == b.mixWeight) && (a.mirror == b.mirror));
+            CHECK((a.absStartTime == b.absStartTime) && (a.absEndTime == b.absEndTime));
+            CHECK((a.absFadeInTime == b.absFadeInTime) && (a.absFadeOutTime == b.absFadeOutTime));
+        }
+        // per-frame state starts fresh
+        CHECK(clone->samples.Empty() && clone->skinMatrices.Empty() && clone->velocities.Empty());
+        CHECK(clone->rootMotionTime < 0.0);
+        CHECK(clone->evalSignature == 0);
+        CHECK(clone->dirty);
+        CHECK(nullptr == clone->sharedLeader);
+    }
+    mgr.newFrame();
+    CHECK(mgr.addActiveInstance(src));
+    for (int i = 0; i < 3; i++) {
+        CHECK(mgr.addActiveInstance(clones[i]));
+    }
+    mgr.evaluate(0.25);
+    for (int i = 0; i < 3; i++) {
+        CHECK(0 == memcmp(clones[i]->samples.begin(), src->samples.begin(), src->samples.Size() * sizeof(float)));
+        CHECK(0 == memcmp(clones[i]->velocities.begin(), src->velocities.begin(), src->velocities.Size() * sizeof(float)));
+        CHECK(0 == memcmp(clones[i]->skinMatrices.begin(), src->skinMatrices.begin(), src->skinMatrices.Size() * sizeof(float)));
+    }
+
+    // clones are destroyed with the label which was current when cloning
+    mgr.destroy(label);
+    for (int i = 0; i < 3; i++) {
+        CHECK(nullptr == mgr.lookupInstance(cloneIds[i]));
+    }
+    CHECK(mgr.instPool.QueryPoolInfo().NumFreeSlots == 3);
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+static bool
+reloadTestLibrary(animMgr& mgr, AnimLibrary* lib, int length, int seed) {
+    // same keys as writeTestKeys() into a library created with testLibrarySetup()
+    AnimLibrarySetup libSetup = testLibrarySetup(lib->Locator.Location().AsCStr(), lib->CurveLayout.Size() / 3, length);
+    const int numKeys = length * lib->Clips[0].KeyStride;
+    Array<int16_t> keys;
+    keys.Reserve(numKeys);
+    for (int i = 0; i < numKeys; i++) {
+        keys.Add(int16_t(((i + seed) * 7919) % 20000 - 10000));
+    }
+    return mgr.reloadLibrary(lib, libSetup, (const uint8_t*) keys.begin(), keys.Size() * int(sizeof(int16_t)));
+}
+
+TEST(AnimReloadLibraryTest) {
+
+    // reload the middle of 3 libraries with fewer and with more keys
+    // while instances play it, the instances must pick up the new keys
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    Id aId = createTestLibrary(mgr, "a", 2, 10);
+    Id bId = createTestLibrary(mgr, "b", 2, 10);
+    Id cId = createTestLibrary(mgr, "c", 2, 10);
+    AnimLibrary* a = mgr.lookupLibrary(aId);
+    AnimLibrary* b = mgr.lookupLibrary(bId);
+    AnimLibrary* c = mgr.lookupLibrary(cId);
+    const int keyStride = b->Clips[0].KeyStride;
+    CHECK(keyStride == 14);
+    CHECK(mgr.numKeys == (3 * 10 * keyStride));
+    int16_t cKeys[10 * 14];
+    memcpy(cKeys, c->Keys.begin(), sizeof(cKeys));
+    animInstance* bInst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibrary(bId)));
+    AnimJob job;
+    mgr.play(bInst, job);
+
+    // mismatching key data is rejected
+    uint8_t dummy[4] = { };
+    CHECK(!mgr.reloadLibrary(b, testLibrarySetup("b", 2, 10), dummy, sizeof(dummy)));
+    CHECK(b->Clips[0].Length == 10);
+
+    for (int pass = 0; pass < 2; pass++) {
+        const int length = (0 == pass) ? 6 : 14;
+        const int oldOffset = b->Keys.Offset();
+        const int oldSize = b->Keys.Size();
+        const int oldNumKeys = mgr.numKeys;
+        CHECK(reloadTestLibrary(mgr, b, length, pass + 1));
+        CHECK(b->Clips.Size() == 2);
+        CHECK(b->Clips[0].Length == length);
+        CHECK(b->Keys.Size() == (length * keyStride));
+        CHECK(b->Clips[0].Keys.begin() == b->Keys.begin());
+        CHECK(a->Keys.Offset() == 0);
+        CHECK(mgr.numKeys == (oldNumKeys - oldSize + b->Keys.Size()));
+        if (0 == pass) {
+            // shrinking keeps the key range, the released tail moves the following keys
+            CHECK(b->Keys.Offset() == oldOffset);
+            CHECK(c->Keys.Offset() == (oldOffset + b->Keys.Size()));
+        }
+        else {
+            // growing appends a new key range, and releases the old range
+            CHECK(c->Keys.Offset() == oldOffset);
+            CHECK(b->Keys.Offset() == (oldOffset + c->Keys.Size()));
+        }
+        CHECK(0 == memcmp(cKeys, c->Keys.begin(), sizeof(cKeys)));
+
+        // compare with a freshly created library with the same keys
+        ResourceLabel label = mgr.resContainer.PushLabel();
+        Id refId = mgr.createLibrary(testLibrarySetup((0 == pass) ? "ref0" : "ref1", 2, length));
+        mgr.resContainer.PopLabel();
+        AnimLibrary* ref = mgr.lookupLibrary(refId);
+        writeTestKeys(mgr, ref, pass + 1);
+        CHECK(0 == memcmp(ref->Keys.begin(), b->Keys.begin(), b->Keys.Size() * sizeof(int16_t)));
+        float refSmp[20];
+        o_assert(ref->SampleStride <= 20);
+        for (int frame = 0; frame < 4; frame++) {
+            const double evalTime = mgr.curTime;
+            mgr.newFrame();
+            CHECK(mgr.addActiveInstance(bInst));
+            mgr.evaluate(0.1);
+            animSequencer::sampleCached(ref->Clips[0], evalTime, refSmp, nullptr);
+            CHECK(0 == memcmp(refSmp, bInst->samples.begin(), b->SampleStride * sizeof(float)));
+        }
+        mgr.destroy(label);
+    }
+    mgr.discard();
+}
+
+TEST(AnimDestroyLabelTest) {
+
+    // destroy every other library and skeleton with one label, the key
+    // and matrix ranges of the survivors are compacted once, and keep
+    // their contents
+    AnimSetup setup;
+    setup.MaxNumLibs = 8;
+    setup.MaxNumSkeletons = 8;
+    animMgr mgr;
+    mgr.setup(setup);
+    const ResourceLabel keepLabel = mgr.resContainer.PushLabel();
+    mgr.resContainer.PopLabel();
+    const ResourceLabel destroyLabel = mgr.resContainer.PushLabel();
+    mgr.resContainer.PopLabel();
+    Id libIds[5];
+    Id skelIds[5];
+    AnimLibrary* libs[5];
+    AnimSkeleton* skels[5];
+    Array<int16_t> keys[5];
+    static const char* libNames[5] = { "lib0", "lib1", "lib2", "lib3", "lib4" };
+    static const char* skelNames[5] = { "skel0", "skel1", "skel2", "skel3", "skel4" };
+    for (int i = 0; i < 5; i++) {
+        mgr.resContainer.PushLabel((i & 1) ? destroyLabel : keepLabel);
+        libIds[i] = mgr.createLibrary(testLibrarySetup(libNames[i], 2, 3 + 2 * i));
+        skelIds[i] = createTestSkeleton(mgr, skelNames[i], 1 + i);
+        mgr.resContainer.PopLabel();
+        libs[i] = mgr.lookupLibrary(libIds[i]);
+        skels[i] = mgr.lookupSkeleton(skelIds[i]);
+        writeTestKeys(mgr, libs[i], i);
+        for (const int16_t key : libs[i]->Keys) {
+            keys[i].Add(key);
+        }
+    }
+    CHECK(mgr.numKeys == (14 * (3 + 5 + 7 + 9 + 11)));
+    CHECK(mgr.matrixPool.Size() == (2 * (1 + 2 + 3 + 4 + 5)));
+
+    mgr.destroy(destroyLabel);
+    for (int i = 1; i < 5; i += 2) {
+        CHECK(nullptr == mgr.lookupLibrary(libIds[i]));
+        CHECK(nullptr == mgr.lookupSkeleton(skelIds[i]));
+    }
+    CHECK(mgr.numKeys == (14 * (3 + 7 + 11)));
+    CHECK(mgr.matrixPool.Size() == (2 * (1 + 3 + 5)));
+    int keyOffset = 0;
+    int matrixOffset = 0;
+    for (int i = 0; i < 5; i += 2) {
+        const AnimLibrary* lib = libs[i];
+        CHECK(lib->Keys.Offset() == keyOffset);
+        CHECK(lib->Keys.Size() == keys[i].Size());
+        CHECK(0 == memcmp(lib->Keys.begin(), keys[i].begin(), keys[i].Size() * sizeof(int16_t)));
+        CHECK(lib->Clips[0].Keys.begin() == lib->Keys.begin());
+        CHECK(lib->Clips[1].Keys.Empty());
+        keyOffset += lib->Keys.Size();
+
+        const AnimSkeleton* skel = skels[i];
+        CHECK(skel->Matrices.Offset() == matrixOffset);
+        CHECK(skel->Matrices.Size() == (2 * skel->NumBones));
+        CHECK(skel->BindPose.begin() == skel->Matrices.begin());
+        CHECK(skel->InvBindPose.begin() == (skel->Matrices.begin() + skel->NumBones));
+        matrixOffset += skel->Matrices.Size();
+    }
+    CHECK(mgr.keyGaps.Empty());
+    CHECK(mgr.matrixGaps.Empty());
+    mgr.discard();
+}
+
+TEST(AnimLeaderLibraryTest) {
+
+    // a leader with a different library is ignored, the follower
+    // plays its own anim jobs (with clip indices of its own library)
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    Id bigLibId = createTestLibrary(mgr, "big", 2, 10);
+    AnimLibrarySetup smallSetup = testLibrarySetup("small", 2, 10);
+    smallSetup.Clips.Erase(1);
+    Id smallLibId = mgr.createLibrary(smallSetup);
+    writeTestKeys(mgr, mgr.lookupLibrary(smallLibId), 0);
+    Id leaderId = mgr.createInstance(AnimInstanceSetup::FromLibrary(bigLibId));
+    animInstance* leader = mgr.lookupInstance(leaderId);
+    AnimInstanceSetup followerSetup = AnimInstanceSetup::FromLibrary(smallLibId);
+    followerSetup.Leader = leaderId;
+    animInstance* follower = mgr.lookupInstance(mgr.createInstance(followerSetup));
+    CHECK(!follower->leaderId.IsValid());
+    AnimJob job;
+    job.ClipIndex = 1;
+    mgr.play(leader, job);
+    job.ClipIndex = 0;
+    mgr.play(follower, job);
+    mgr.newFrame();
+    CHECK(mgr.addActiveInstance(leader));
+    CHECK(mgr.addActiveInstance(follower));
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(nullptr == follower->sharedLeader);
+    CHECK(follower->sequencer.items.Size() == 1);
+    CHECK(follower->sequencer.items[0].clipIndex == 0);
+    mgr.discard();
+}
+
+TEST(AnimCallerOwnedOutputTest) {
+
+    // an instance evaluating into caller-owned buffers gets the same
+    // outputs as one in the pools, but no InstanceInfo, its dirty flag
+    // tells whether the buffers were rewritten
+    AnimSetup setup;
+    setup.SkipUnchangedInstances = true;
+    animMgr mgr;
+    mgr.setup(setup);
+    Id libId = createTestLibrary(mgr, "lib", 2, 10);
+    Id skelId = createTestSkeleton(mgr, "skel", 2);
+    const int numSamples = mgr.lookupLibrary(libId)->SampleStride;
+    float samples[2][20];
+    float skinMatrices[2][2 * 12];
+    o_assert(numSamples <= 20);
+    animInstance* pooled[2];
+    animInstance* owned[2];
+    for (int i = 0; i < 2; i++) {
+        pooled[i] = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId)));
+        owned[i] = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId)));
+        AnimJob job;
+        job.ClipIndex = i;
+        mgr.play(pooled[i], job);
+        mgr.play(owned[i], job);
+    }
+    for (int frame = 0; frame < 3; frame++) {
+        mgr.newFrame();
+        for (int i = 0; i < 2; i++) {
+            CHECK(mgr.addActiveInstance(pooled[i]));
+            CHECK(mgr.addActiveInstance(owned[i], samples[i], skinMatrices[i]));
+        }
+        mgr.evaluate(1.0 / 60.0);
+        CHECK(mgr.skinMatrixInfo.InstanceInfos.Size() == 2);
+        for (int i = 0; i < 2; i++) {
+            CHECK(owned[i]->skinInfoIndex == InvalidIndex);
+            CHECK(owned[i]->samples.begin() == samples[i]);
+            CHECK(owned[i]->skinMatrices.begin() == skinMatrices[i]);
+            CHECK(0 == memcmp(samples[i], pooled[i]->samples.begin(), numSamples * sizeof(float)));
+            CHECK(0 == memcmp(skinMatrices[i], pooled[i]->skinMatrices.begin(), sizeof(skinMatrices[i])));
+            CHECK(pooled[i]->skinMatrices.begin() == (mgr.skinMatrixInfo.SkinMatrixTable + pooled[i]->skinMatrices.Offset()));
+        }
+        // the animated clip rewrites the outputs every frame, the static clip only in the first
+        CHECK(owned[0]->dirty);
+        CHECK(owned[1]->dirty == (0 == frame));
+        CHECK(mgr.skinMatrixInfo.InstanceInfos[1].Dirty == (0 == frame));
+    }
+    mgr.discard();
+}
+
+TEST(AnimGroupEvalTest) {
+
+    // evaluate the same instances one by one, and with sorting, group
+    // sampling and group skinning, the outputs must be identical, the
+    // instance counts per clip and skeleton aren't multiples of the lanes
+    static const int numInsts = 19;
+    AnimSetup setups[3];
+    setups[0].MinSampleGroupSize = 0;
+    setups[0].MinSkinGroupSize = 0;
+    setups[1].MinSampleGroupSize = 2;
+    setups[1].MinSkinGroupSize = 2;
+    setups[2] = setups[1];
+    setups[2].SortActiveInstances = true;
+    animMgr mgrs[3];
+    animInstance* insts[3][numInsts];
+    for (int m = 0; m < 3; m++) {
+        animMgr& mgr = mgrs[m];
+        mgr.setup(setups[m]);
+        AnimLibrarySetup libSetup = testLibrarySetup("lib", 2, 10);
+        libSetup.RootMotionCurve = 0;
+        Id libId = mgr.createLibrary(libSetup);
+        writeTestKeys(mgr, mgr.lookupLibrary(libId), 0);
+        Id skelIds[2] = { createTestSkeleton(mgr, "skel0", 2), createTestSkeleton(mgr, "skel1", 2) };
+        for (int i = 0; i < numInsts; i++) {
+            insts[m][i] = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelIds[i % 2])));
+            AnimJob job;
+            job.ClipIndex = (0 == (i % 3)) ? 1 : 0;
+            job.StartTime = -0.013f * i;
+            mgr.play(insts[m][i], job);
+        }
+    }
+    for (int frame = 0; frame < 4; frame++) {
+        for (int m = 0; m < 3; m++) {
+            mgrs[m].newFrame();
+            for (int i = 0; i < numInsts; i++) {
+                CHECK(mgrs[m].addActiveInstance(insts[m][i]));
+            }
+            mgrs[m].evaluate(0.05);
+        }
+        for (int m = 1; m < 3; m++) {
+            const animMgr& mgr = mgrs[m];
+            CHECK(mgr.sampleGroupItems.Size() == numInsts);
+            CHECK(mgr.skinGroupInstances.Size() == numInsts);
+            CHECK(mgr.skinMatrixInfo.InstanceInfos.Size() == numInsts);
+            for (int i = 0; i < numInsts; i++) {
+                const animInstance* ref = insts[0][i];
+                const animInstance* inst = insts[m][i];
+                CHECK(0 == memcmp(ref->samples.begin(), inst->samples.begin(), ref->samples.Size() * sizeof(float)));
+                CHECK(0 == memcmp(ref->skinMatrices.begin(), inst->skinMatrices.begin(), ref->skinMatrices.Size() * sizeof(float)));
+                CHECK(ref->rootMotion == inst->rootMotion);
+                // InstanceInfos and skin matrix slices keep the AddActiveInstance order
+                CHECK(inst->skinMatrices.Offset() == ref->skinMatrices.Offset());
+                CHECK(inst->skinInfoIndex == i);
+                CHECK(mgr.skinMatrixInfo.InstanceInfos[i].Instance == inst->Id);
+                CHECK(mgr.skinMatrixInfo.InstanceInfos[i].ShaderInfo == mgrs[0].skinMatrixInfo.InstanceInfos[i].ShaderInfo);
+            }
+        }
+    }
+    // the evaluation order is sorted by clip
+    for (int i = 1; i < numInsts; i++) {
+        const animInstance* prev = mgrs[2].activeInstances[i - 1];
+        const animInstance* cur = mgrs[2].activeInstances[i];
+        CHECK(prev->sequencer.items[0].clipIndex <= cur->sequencer.items[0].clipIndex);
+    }
+    for (int m = 0; m < 3; m++) {
+        mgrs[m].discard();
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+checkSameSamples(const AnimClip& ref, const AnimClip& clip, animKeyCache* keyCache, int numSamples) {
+    // sample both clips over more than one loop, the results must be identical
+    float refSmp[20];
+    float smp[20];
+    o_assert(numSamples <= 20);
+    for (int i = 0; i < 40; i++) {
+        const double t = i * 0.013;
+        animSequencer::sampleCached(ref, t, refSmp, nullptr);
+        animSequencer::sampleCached(clip, t, smp, keyCache);
+        CHECK(0 == memcmp(refSmp, smp, numSamples * sizeof(float)));
+    }
+}
+
+TEST(AnimKeySourcesTest) {
+
+    // the key cache, hot clip keys and delta keys must sample exactly
+    // like unpacking the int16 keys, the key cache has 4 row slots,
+    // and the hot key pool has room for one clip
+    AnimSetup setup;
+    setup.KeyCacheCapacity = 4 * 14;
+    setup.HotKeyPoolCapacity = 10 * 14;
+    animMgr mgr;
+    mgr.setup(setup);
+    Id refId = createTestLibrary(mgr, "ref", 2, 10);
+    AnimLibrarySetup deltaSetup = testLibrarySetup("delta", 2, 10);
+    deltaSetup.Clips[0].DeltaKeys = true;
+    Id deltaId = mgr.createLibrary(deltaSetup);
+    writeTestKeys(mgr, mgr.lookupLibrary(deltaId), 0);
+    Id hotId = createTestLibrary(mgr, "hot", 2, 10);
+    const AnimLibrary* ref = mgr.lookupLibrary(refId);
+    const AnimLibrary* delta = mgr.lookupLibrary(deltaId);
+    AnimLibrary* hot = mgr.lookupLibrary(hotId);
+    const int numSamples = ref->SampleStride;
+    CHECK(mgr.keyCache.isValid());
+    CHECK(delta->Clips[0].DeltaKeys != nullptr);
+    CHECK(nullptr == delta->Clips[1].DeltaKeys);
+
+    // key cache and delta keys
+    checkSameSamples(ref->Clips[0], ref->Clips[0], &mgr.keyCache, numSamples);
+    checkSameSamples(ref->Clips[0], delta->Clips[0], nullptr, numSamples);
+    checkSameSamples(ref->Clips[1], delta->Clips[1], nullptr, numSamples);
+
+    // key rows 0 and 4 map to the same slot
+    const AnimClip& clip = hot->Clips[0];
+    float row[14];
+    CHECK(clip.KeyStride == 14);
+    const float* cached = mgr.keyCache.lookup(clip, 0);
+    animKeyCache::decodeRow(clip, 0, row);
+    CHECK(cached && (0 == memcmp(cached, row, sizeof(row))));
+    CHECK(mgr.keyCache.isCached(clip, 0));
+    mgr.keyCache.lookup(clip, 1);
+    CHECK(mgr.keyCache.isCached(clip, 0));
+    mgr.keyCache.lookup(clip, 4);
+    CHECK(!mgr.keyCache.isCached(clip, 0));
+    CHECK(mgr.keyCache.isCached(clip, 1));
+
+    // writing keys and destroying libraries invalidates the cache
+    mgr.keyCache.lookup(clip, 0);
+    writeTestKeys(mgr, hot, 1);
+    CHECK(!mgr.keyCache.isCached(clip, 0));
+    cached = mgr.keyCache.lookup(clip, 0);
+    animKeyCache::decodeRow(clip, 0, row);
+    CHECK(0 == memcmp(cached, row, sizeof(row)));
+    writeTestKeys(mgr, hot, 0);
+    mgr.keyCache.lookup(ref->Clips[0], 0);
+    CHECK(mgr.keyCache.isCached(ref->Clips[0], 0));
+    ResourceLabel label = mgr.resContainer.PushLabel();
+    Id tmpId = createTestLibrary(mgr, "tmp", 2, 10);
+    mgr.resContainer.PopLabel();
+    mgr.destroy(label);
+    CHECK(nullptr == mgr.lookupLibrary(tmpId));
+    CHECK(!mgr.keyCache.isCached(ref->Clips[0], 0));
+
+    // a played clip is promoted at the next hot clip update
+    animInstance* inst = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibrary(hotId)));
+    AnimJob job;
+    mgr.play(inst, job);
+    CHECK(nullptr == clip.HotKeys);
+    for (int frame = 0; frame < animMgr::hotClipUpdateFrames; frame++) {
+        mgr.newFrame();
+        CHECK(mgr.addActiveInstance(inst));
+        mgr.evaluate(1.0 / 60.0);
+    }
+    CHECK(clip.HotKeys == mgr.hotKeyPool);
+    CHECK(nullptr == hot->Clips[1].HotKeys);
+    CHECK(mgr.hotClips.Size() == 1);
+    checkSameSamples(ref->Clips[0], clip, nullptr, numSamples);
+
+    // the hot keys stay in place while the clip is played, and are
+    // released once the decaying play count of an unplayed clip is 0
+    for (int frame = 0; frame < animMgr::hotClipUpdateFrames; frame++) {
+        mgr.newFrame();
+        CHECK(mgr.addActiveInstance(inst));
+        mgr.evaluate(1.0 / 60.0);
+    }
+    CHECK(clip.HotKeys == mgr.hotKeyPool);
+    int numUpdates = 0;
+    while (clip.HotKeys && (numUpdates < 16)) {
+        for (int frame = 0; frame < animMgr::hotClipUpdateFrames; frame++) {
+            mgr.newFrame();
+            mgr.evaluate(1.0 / 60.0);
+        }
+        numUpdates++;
+    }
+    CHECK(nullptr == clip.HotKeys);
+    CHECK(numUpdates > 1);
+    CHECK(mgr.hotClips.Empty());
+    CHECK(0 == mgr.hotKeyBlocks.numAllocated());
+    checkSameSamples(ref->Clips[0], clip, nullptr, numSamples);
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+static Id
+createMirrorSkeleton(animMgr& mgr, const char* name, int mirrorAxis) {
+    // a root bone which mirrors itself, and a pair of mirrored child bones
+    AnimSkeletonSetup skelSetup;
+    skelSetup.Locator = Locator::NonShared(name);
+    skelSetup.MirrorAxis = mirrorAxis;
+    skelSetup.Bones.Add(AnimBoneSetup("root", -1, glm::mat4(), glm::mat4()));
+    skelSetup.Bones.Add(AnimBoneSetup("left", 0, glm::mat4(), glm::mat4()));
+    skelSetup.Bones.Add(AnimBoneSetup("right", 0, glm::mat4(), glm::mat4()));
+    if (InvalidIndex != mirrorAxis) {
+        skelSetup.Bones[1].MirrorIndex = 2;
+        skelSetup.Bones[2].MirrorIndex = 1;
+    }
+    return mgr.createSkeleton(skelSetup);
+}
+
+TEST(AnimMirrorTest) {
+
+    // a mirrored job swaps the samples of the bone pair, and negates the
+    // translation along the mirror axis and the rotation axis components
+    // perpendicular to it, without a mirror map it plays unmirrored
+    static const int mirrorBone[3] = { 0, 2, 1 };
+    for (int mode = 0; mode < 2; mode++) {
+        AnimSetup setup;
+        setup.EvalMode = (0 == mode) ? AnimEvalMode::Float : AnimEvalMode::FixedPoint;
+        animMgr mgr;
+        mgr.setup(setup);
+        AnimLibrarySetup libSetup = testLibrarySetup("lib", 3, 4);
+        Id libId = mgr.createLibrary(libSetup);
+        writeTestKeys(mgr, mgr.lookupLibrary(libId), 0);
+        libSetup.Locator = Locator::NonShared("rootMotionLib");
+        libSetup.RootMotionCurve = 0;
+        Id rootMotionLibId = mgr.createLibrary(libSetup);
+        writeTestKeys(mgr, mgr.lookupLibrary(rootMotionLibId), 0);
+        CHECK(mgr.lookupLibrary(libId)->NumBones == 3);
+        Id mirrorSkelId = createMirrorSkeleton(mgr, "mirrorSkel", 0);
+        Id plainSkelId = createMirrorSkeleton(mgr, "plainSkel", InvalidIndex);
+        animInstance* plain = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, mirrorSkelId)));
+        animInstance* mirrored = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, mirrorSkelId)));
+        animInstance* unmirrored = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, plainSkelId)));
+        animInstance* plainRoot = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(rootMotionLibId, mirrorSkelId)));
+        animInstance* mirroredRoot = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(rootMotionLibId, mirrorSkelId)));
+        CHECK(nullptr == unmirrored->sequencer.mirrorSkeleton);
+        AnimJob job;
+        mgr.play(plain, job);
+        mgr.play(plainRoot, job);
+        job.Mirror = true;
+        mgr.play(mirrored, job);
+        mgr.play(unmirrored, job);
+        mgr.play(mirroredRoot, job);
+        glm::vec4 plainMotion(0.0f);
+        glm::vec4 mirroredMotion(0.0f);
+        for (int frame = 0; frame < 6; frame++) {
+            mgr.newFrame();
+            CHECK(mgr.addActiveInstance(plain));
+            CHECK(mgr.addActiveInstance(mirrored));
+            CHECK(mgr.addActiveInstance(unmirrored));
+            CHECK(mgr.addActiveInstance(plainRoot));
+            CHECK(mgr.addActiveInstance(mirroredRoot));
+            mgr.evaluate(0.03);
+            for (int bone = 0; bone < 3; bone++) {
+                const float* src = plain->samples.begin() + mirrorBone[bone] * 10;
+                const float* dst = mirrored->samples.begin() + bone * 10;
+                CHECK(-src[0] == dst[0]);
+                CHECK((src[1] == dst[1]) && (src[2] == dst[2]));
+                CHECK((src[3] == dst[3]) && (-src[4] == dst[4]) && (-src[5] == dst[5]) && (src[6] == dst[6]));
+                CHECK((src[7] == dst[7]) && (src[8] == dst[8]) && (src[9] == dst[9]));
+            }
+            CHECK(0 == memcmp(plain->samples.begin(), unmirrored->samples.begin(), plain->samples.Size() * sizeof(float)));
+            // the root bone mirrors itself, its root motion is negated along the mirror axis
+            CHECK(-plainRoot->rootMotion.x == mirroredRoot->rootMotion.x);
+            CHECK(plainRoot->rootMotion.y == mirroredRoot->rootMotion.y);
+            CHECK(plainRoot->rootMotion.z == mirroredRoot->rootMotion.z);
+            plainMotion += plainRoot->rootMotion;
+            mirroredMotion += mirroredRoot->rootMotion;
+        }
+        CHECK(plainMotion.x != 0.0f);
+        CHECK(-plainMotion.x == mirroredMotion.x);
+        mgr.discard();
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+checkVelocities(animSequencer& seq, const AnimLibrary* lib, double t, animKeyCache* keyCache, int lod) {
+    // the velocities must match the central difference of the samples,
+    // the samples of each item and the fade weight are linear between
+    // keys, so the blended samples are quadratic and the difference is exact
+    const double h = 0.005;
+    const int numSamples = lib->SampleStride;
+    float smp[20], vel[20], smp0[20], smp1[20];
+    CHECK(seq.eval(lib, t, smp, numSamples, vel, keyCache, lod));
+    CHECK(seq.eval(lib, t - h, smp0, numSamples, nullptr, nullptr, lod));
+    CHECK(seq.eval(lib, t + h, smp1, numSamples, nullptr, nullptr, lod));
+    for (int i = 0; i < numSamples; i++) {
+        CHECK_CLOSE((smp1[i] - smp0[i]) / float(2.0 * h), vel[i], 0.01f);
+    }
+}
+
+TEST(AnimVelocityTest) {
+
+    // the 2nd job fades in over the 1st, so the velocities include the
+    // derivative of the fade weight, sample times stay away from the key
+    // boundaries of both jobs at full rate and at LOD 1
+    AnimSetup setup;
+    setup.KeyCacheCapacity = 4 * 14;
+    animMgr mgr;
+    mgr.setup(setup);
+    AnimLibrarySetup libSetup = testLibrarySetup("lib", 2, 10);
+    libSetup.Clips[0].NumLods = 1;
+    Id libId = mgr.createLibrary(libSetup);
+    const AnimLibrary* lib = mgr.lookupLibrary(libId);
+    writeTestKeys(mgr, mgr.lookupLibrary(libId), 0);
+    const int numSamples = lib->SampleStride;
+    AnimInstanceSetup instSetup = AnimInstanceSetup::FromLibrary(libId);
+    instSetup.Velocities = true;
+    animInstance* inst = mgr.lookupInstance(mgr.createInstance(instSetup));
+    AnimJob job;
+    mgr.play(inst, job);
+    job.TrackIndex = 1;
+    job.StartTime = 0.05f;
+    job.FadeIn = 0.2f;
+    job.MixWeight = 0.8f;
+    mgr.play(inst, job);
+    static const double times[3] = { 0.07, 0.15, 0.22 };
+    for (double t : times) {
+        checkVelocities(inst->sequencer, lib, t, nullptr, 0);
+        checkVelocities(inst->sequencer, lib, t, &mgr.keyCache, 0);
+        checkVelocities(inst->sequencer, lib, t, nullptr, 1);
+    }
+
+    // the key cache doesn't change the velocities
+    float vel[20], cachedVel[20], smp[20];
+    CHECK(inst->sequencer.eval(lib, 0.15, smp, numSamples, vel));
+    CHECK(inst->sequencer.eval(lib, 0.15, smp, numSamples, cachedVel, &mgr.keyCache));
+    CHECK(0 == memcmp(vel, cachedVel, numSamples * sizeof(float)));
+
+    // evaluating through the manager uses the instance LOD
+    mgr.newFrame();
+    mgr.evaluate(0.15);
+    mgr.newFrame();
+    CHECK(mgr.addActiveInstance(inst, nullptr, nullptr, 1));
+    mgr.evaluate(0.0);
+    CHECK(inst->sequencer.eval(lib, 0.15, smp, numSamples, vel, nullptr, 1));
+    CHECK(0 == memcmp(inst->samples.begin(), smp, numSamples * sizeof(float)));
+    CHECK(0 == memcmp(inst->velocities.begin(), vel, numSamples * sizeof(float)));
+    CHECK(inst->sequencer.eval(lib, 0.15, smp, numSamples, vel));
+    CHECK(0 != memcmp(inst->samples.begin(), smp, numSamples * sizeof(float)));
+    mgr.discard();
+}
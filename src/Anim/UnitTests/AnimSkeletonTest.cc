@@ -44,3 +44,59 @@ TEST(AnimSkeletonTest) {
     CHECK(!mgr.isValid);
     CHECK(mgr.matrixPool.Size() == 0);
 }
+
+TEST(AnimSkinMatrixTableTest) {
+
+    // with streaming stores, instances start at cache lines, and the
+    // dirty ranges of adjacent instances include the padding between them
+    AnimSetup setup;
+    setup.StreamSkinMatrices = true;
+    animMgr mgr;
+    mgr.setup(setup);
+    CHECK(0 == (uintptr_t(mgr.skinMatrixInfo.SkinMatrixTable) & (animMgr::skinMatrixAlignment - 1)));
+
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = "lib";
+    for (int i = 0; i < 3; i++) {
+        libSetup.CurveLayout.Add(AnimCurveFormat::Float3);
+        libSetup.CurveLayout.Add(AnimCurveFormat::Float4);
+        libSetup.CurveLayout.Add(AnimCurveFormat::Float3);
+    }
+    AnimClipSetup clipSetup;
+    clipSetup.Name = "clip";
+    clipSetup.Length = 1;
+    clipSetup.KeyDuration = 0.04f;
+    for (int i = 0; i < 3; i++) {
+        clipSetup.Curves.Add(AnimCurveSetup(true, 0.0f, 0.0f, 0.0f, 0.0f));
+        clipSetup.Curves.Add(AnimCurveSetup(true, 0.0f, 0.0f, 0.0f, 1.0f));
+        clipSetup.Curves.Add(AnimCurveSetup(true, 1.0f, 1.0f, 1.0f, 0.0f));
+    }
+    libSetup.Clips.Add(clipSetup);
+    Id libId = mgr.createLibrary(libSetup);
+    AnimSkeletonSetup skelSetup;
+    skelSetup.Locator = "skel";
+    skelSetup.Bones = {
+        { "root", -1, glm::mat4(), glm::mat4() },
+        { "spine0", 0, glm::mat4(), glm::mat4() },
+        { "spine1", 1, glm::mat4(), glm::mat4() }
+    };
+    Id skelId = mgr.createSkeleton(skelSetup);
+    animInstance* insts[3];
+    for (int i = 0; i < 3; i++) {
+        insts[i] = mgr.lookupInstance(mgr.createInstance(AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId)));
+        AnimJob job;
+        mgr.play(insts[i], job);
+    }
+    mgr.newFrame();
+    for (int i = 0; i < 3; i++) {
+        CHECK(mgr.addActiveInstance(insts[i]));
+        CHECK(0 == (uintptr_t(insts[i]->skinMatrices.begin()) & (animMgr::skinMatrixAlignment - 1)));
+    }
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(mgr.skinMatrixInfo.DirtyRanges.Size() == 1);
+    CHECK(mgr.skinMatrixInfo.DirtyRanges[0].Offset == 0);
+    // 3 bones take 144 bytes, padded to 3 cache lines
+    CHECK(mgr.skinMatrixInfo.DirtyRanges[0].Size == (2 * 3 * animMgr::skinMatrixAlignment + 3 * 12 * int(sizeof(float))));
+
+    mgr.discard();
+}
@@ -223,3 +223,75 @@ TEST(animSequencerTest) {
     CHECK(!sequencer.items[1].valid);
 }
 
+
+TEST(animSequencerEncodeTest) {
+
+    // times are multiples of the encoding tick, so decoding must be exact
+    animSequencer src;
+    AnimJob job0;
+    job0.ClipIndex = 3;
+    job0.TrackIndex = 0;
+    job0.FadeIn = 0.25f;
+    src.add(10.0, 100, job0, 2.0);
+    AnimJob job1;
+    job1.ClipIndex = 7;
+    job1.TrackIndex = 2;
+    job1.MixWeight = 0.5f;
+    job1.StartTime = 1.5f;
+    job1.Duration = 4.0f;
+    job1.FadeIn = job1.FadeOut = 0.125f;
+    job1.Mirror = true;
+    src.add(10.0, 101, job1, 2.0);
+
+    uint8_t full[animSequencer::maxEncodedBytes];
+    const int fullBytes = src.encode(full, sizeof(full), nullptr);
+    CHECK(fullBytes > 0);
+    animSequencer dst;
+    CHECK(dst.decode(full, fullBytes, nullptr));
+    CHECK(dst.items.Size() == 2);
+    for (int i = 0; i < 2; i++) {
+        CHECK(dst.items[i].id == src.items[i].id);
+        CHECK(dst.items[i].valid);
+        CHECK(dst.items[i].clipIndex == src.items[i].clipIndex);
+        CHECK(dst.items[i].trackIndex == src.items[i].trackIndex);
+        CHECK(dst.items[i].mixWeight == src.items[i].mixWeight);
+        CHECK(dst.items[i].mirror == src.items[i].mirror);
+        CHECK(dst.items[i].absStartTime == src.items[i].absStartTime);
+        CHECK(dst.items[i].absFadeInTime == src.items[i].absFadeInTime);
+        CHECK(dst.items[i].absFadeOutTime == src.items[i].absFadeOutTime);
+        CHECK(dst.items[i].absEndTime == src.items[i].absEndTime);
+    }
+    CHECK(dst.items[0].absEndTime == DBL_MAX);
+
+    // an unchanged state encodes to 2 bytes per item as delta
+    uint8_t delta[animSequencer::maxEncodedBytes];
+    int deltaBytes = src.encode(delta, sizeof(delta), &dst);
+    CHECK(deltaBytes == 5);
+    animSequencer dst1;
+    CHECK(dst1.decode(delta, deltaBytes, &dst));
+    CHECK(dst1.items.Size() == 2);
+    CHECK(dst1.items[1].id == 101);
+    CHECK(dst1.items[1].absEndTime == src.items[1].absEndTime);
+
+    // stop a job, and add a new one
+    src.stop(12.0, 100, false);
+    AnimJob job2;
+    job2.ClipIndex = 1;
+    job2.TrackIndex = 1;
+    src.add(12.0, 102, job2, 2.0);
+    deltaBytes = src.encode(delta, sizeof(delta), &dst);
+    CHECK(deltaBytes > 5);
+    CHECK(dst1.decode(delta, deltaBytes, &dst));
+    CHECK(dst1.items.Size() == src.items.Size());
+    for (int i = 0; i < src.items.Size(); i++) {
+        CHECK(dst1.items[i].id == src.items[i].id);
+        CHECK(dst1.items[i].clipIndex == src.items[i].clipIndex);
+        CHECK(dst1.items[i].absStartTime == src.items[i].absStartTime);
+        CHECK(dst1.items[i].absEndTime == src.items[i].absEndTime);
+    }
+
+    // a delta stream can't be decoded without its baseline, truncated streams are rejected
+    CHECK(!dst1.decode(delta, deltaBytes, nullptr));
+    CHECK(!dst1.decode(full, fullBytes - 1, nullptr));
+    CHECK(0 == src.encode(full, 4, nullptr));
+}
@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------
+//  animBlockAlloc.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "animBlockAlloc.h"
+
+namespace Oryol {
+namespace _priv {
+
+//------------------------------------------------------------------------------
+void
+animBlockAlloc::setup(int cap) {
+    o_assert_dbg(cap >= 0);
+    this->capacity = cap;
+    this->endOffset = 0;
+    this->allocated = 0;
+    this->freeBlocks.Clear();
+}
+
+//------------------------------------------------------------------------------
+void
+animBlockAlloc::discard() {
+    o_assert_dbg(0 == this->allocated);
+    this->capacity = 0;
+    this->endOffset = 0;
+    this->freeBlocks.Clear();
+}
+
+//------------------------------------------------------------------------------
+int
+animBlockAlloc::alloc(int num) {
+    o_assert_dbg(num > 0);
+
+    // first-fit in the free blocks, otherwise append at the end
+    for (int i = 0; i < this->freeBlocks.Size(); i++) {
+        block& blk = this->freeBlocks[i];
+        if (blk.size >= num) {
+            const int offset = blk.offset;
+            blk.offset += num;
+            blk.size -= num;
+            if (0 == blk.size) {
+                this->freeBlocks.Erase(i);
+            }
+            this->allocated += num;
+            return offset;
+        }
+    }
+    if ((this->endOffset + num) <= this->capacity) {
+        const int offset = this->endOffset;
+        this->endOffset += num;
+        this->allocated += num;
+        return offset;
+    }
+    return InvalidIndex;
+}
+
+//------------------------------------------------------------------------------
+void
+animBlockAlloc::free(int offset, int num) {
+    o_assert_dbg((offset >= 0) && (num > 0) && ((offset + num) <= this->endOffset));
+    this->allocated -= num;
+    o_assert_dbg(this->allocated >= 0);
+
+    // find the insert position, and merge with the free neighbours
+    int i = 0;
+    while ((i < this->freeBlocks.Size()) && (this->freeBlocks[i].offset < offset)) {
+        i++;
+    }
+    block blk;
+    blk.offset = offset;
+    blk.size = num;
+    if ((i > 0) && ((this->freeBlocks[i-1].offset + this->freeBlocks[i-1].size) >= offset)) {
+        o_assert_dbg((this->freeBlocks[i-1].offset + this->freeBlocks[i-1].size) == offset);
+        i--;
+        blk.offset = this->freeBlocks[i].offset;
+        blk.size += this->freeBlocks[i].size;
+        this->freeBlocks.Erase(i);
+    }
+    if ((i < this->freeBlocks.Size()) && (this->freeBlocks[i].offset <= (blk.offset + blk.size))) {
+        o_assert_dbg(this->freeBlocks[i].offset == (blk.offset + blk.size));
+        blk.size += this->freeBlocks[i].size;
+        this->freeBlocks.Erase(i);
+    }
+
+    // a free block at the end shrinks the used range instead
+    if ((blk.offset + blk.size) == this->endOffset) {
+        this->endOffset = blk.offset;
+    }
+    else {
+        this->freeBlocks.Insert(i, blk);
+    }
+}
+
+} // namespace _priv
+} // namespace Oryol
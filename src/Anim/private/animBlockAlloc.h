@@ -0,0 +1,59 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::_priv::animBlockAlloc
+    @ingroup _priv
+    @brief allocate contiguous item blocks from a fixed-capacity pool
+
+    Hands out blocks of items (as offsets into a pool owned by the
+    caller) from a first-fit list of free blocks, or from the end of
+    the used range. Freed blocks are merged with their free neighbours,
+    and a free block at the end shrinks the used range, so the owner
+    can trim the pool to end(). Allocated blocks never move.
+*/
+#include "Core/Containers/Array.h"
+
+namespace Oryol {
+namespace _priv {
+
+class animBlockAlloc {
+public:
+    /// setup with the pool capacity in number of items
+    void setup(int capacity);
+    /// discard the allocator
+    void discard();
+    /// allocate a block of num items, return offset or InvalidIndex if the pool is exhausted
+    int alloc(int num);
+    /// free a block of num items at offset
+    void free(int offset, int num);
+    /// return the end of the used range (all items at and after end() are free)
+    int end() const;
+    /// return the number of allocated items
+    int numAllocated() const;
+
+private:
+    struct block {
+        int offset = 0;
+        int size = 0;
+    };
+    int capacity = 0;
+    int endOffset = 0;
+    int allocated = 0;
+    /// free blocks before endOffset, sorted by offset
+    Array<block> freeBlocks;
+};
+
+//------------------------------------------------------------------------------
+inline int
+animBlockAlloc::end() const {
+    return this->endOffset;
+}
+
+//------------------------------------------------------------------------------
+inline int
+animBlockAlloc::numAllocated() const {
+    return this->allocated;
+}
+
+} // namespace _priv
+} // namespace Oryol
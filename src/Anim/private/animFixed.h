@@ -0,0 +1,90 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::_priv::animFixed
+    @ingroup _priv
+    @brief fixed-point helpers for deterministic animation evaluation
+
+    Sample values and matrix elements are Q16.16 in an int32_t, key
+    positions and mixing weights are Q1.15. All rounding is done
+    through roundShift() which rounds half towards positive infinity
+    (relies on arithmetic right-shift of signed values, which is what
+    all x86-64 compilers do). Conversions from and to float only consist
+    of a single IEEE operation each and are thus reproducible.
+*/
+#include "Core/Types.h"
+#include <math.h>
+
+namespace Oryol {
+namespace _priv {
+
+struct animFixed {
+    /// number of fractional bits in sample values
+    static const int FracBits = 16;
+    /// 1.0 as sample value
+    static const int32_t One = 1<<FracBits;
+    /// number of fractional bits in key positions and weights
+    static const int UnitBits = 15;
+    /// 1.0 as key position or weight
+    static const int32_t Unit = 1<<UnitBits;
+    /// number of fractional bits in curve magnitudes
+    static const int MagnitudeBits = 31;
+
+    /// shift right with rounding
+    static int64_t roundShift(int64_t val, int shift) {
+        return (val + (int64_t(1)<<(shift-1))) >> shift;
+    };
+    /// multiply 2 Q16.16 values
+    static int32_t mul(int32_t a, int32_t b) {
+        return int32_t(roundShift(int64_t(a) * int64_t(b), FracBits));
+    };
+    /// lerp between 2 Q16.16 values with a Q1.15 weight
+    static int32_t lerp(int32_t a, int32_t b, int32_t w) {
+        return a + int32_t(roundShift(int64_t(b - a) * int64_t(w), UnitBits));
+    };
+    /// convert float to Q16.16
+    static int32_t fromFloat(float f) {
+        return int32_t(floor(double(f) * double(One) + 0.5));
+    };
+    /// convert Q16.16 to float
+    static float toFloat(int32_t v) {
+        return float(v) * (1.0f / float(One));
+    };
+    /// convert a [0..1] value to Q1.15 (clamped)
+    static int32_t fromUnit(double d) {
+        int32_t v = int32_t(d * double(Unit));
+        if (v < 0) v = 0;
+        else if (v > Unit) v = Unit;
+        return v;
+    };
+    /// return true if a float value can be converted to Q16.16
+    static bool isValidValue(float f) {
+        return (f >= -32768.0f) && (f <= 32767.0f);
+    };
+    /// clamp a float value into the Q16.16 range
+    static float clampValue(float f) {
+        return f < -32768.0f ? -32768.0f : (f > 32767.0f ? 32767.0f : f);
+    };
+    /// return true if a premultiplied key magnitude can be converted to Q0.31
+    static bool isValidMagnitude(float m) {
+        return (m >= 0.0f) && (m < 1.0f);
+    };
+    /// clamp a premultiplied key magnitude into the Q0.31 range
+    static float clampMagnitude(float m) {
+        const float maxMagnitude = 1.0f - 1.0f / 16777216.0f;
+        return m < 0.0f ? 0.0f : (m > maxMagnitude ? maxMagnitude : m);
+    };
+    /// convert a premultiplied (by 1/32767) key magnitude to Q0.31
+    static int32_t fromMagnitude(float m) {
+        o_assert_dbg((m >= 0.0f) && (m < 1.0f));
+        return int32_t(floor(double(m) * double(int64_t(1)<<MagnitudeBits) + 0.5));
+    };
+    /// interpolate and unpack 2 int16 keys with a Q1.15 key position into a Q16.16 value
+    static int32_t unpackLerp(int16_t k0, int16_t k1, int32_t keyPos, int32_t magnitude) {
+        const int64_t k = (int64_t(k0)<<UnitBits) + int64_t(k1 - k0) * int64_t(keyPos);
+        return int32_t(roundShift(k * int64_t(magnitude), UnitBits + MagnitudeBits - FracBits));
+    };
+};
+
+} // namespace _priv
+} // namespace Oryol
@@ -26,15 +26,59 @@ public:
     animSequencer sequencer;
     /// anim evaluation result (only valid for active instances) 
     Slice<float> samples;
+    /// anim evaluation result as Q16.16 (only valid for active instances in AnimEvalMode::FixedPoint)
+    Slice<int32_t> fixedSamples;
     /// skeleton evaluation result as 4x3 transposed matrices (only valid for active instances)
     Slice<float> skinMatrices;
+    /// true if the instance outputs sample velocities
+    bool hasVelocities = false;
+    /// per-second velocities of the samples (only valid for active instances with velocities)
+    Slice<float> velocities;
+    /// root motion since previous evaluation (only if library has a root motion curve)
+    glm::vec4 rootMotion;
+    /// time of previous root motion evaluation (< 0.0 if not evaluated yet)
+    double rootMotionTime = -1.0;
+    /// hash of the evaluation inputs of the previous evaluation
+    uint64_t evalSignature = 0;
+    /// frame index of the previous evaluation
+    uint32_t evalFrameIndex = 0;
+    /// true if the samples and skin matrices were recomputed in the current frame
+    bool dirty = true;
+    /// index into AnimSkinMatrixInfo::InstanceInfos (only valid for active instances)
+    int skinInfoIndex = InvalidIndex;
+    /// requested clip LOD in the current frame (0 is full key rate)
+    int lod = 0;
+    /// true if the skin matrices were copied from baked skin matrices in the current frame
+    bool baked = false;
+    /// optional leader instance whose anim jobs are played
+    Oryol::Id leaderId;
+    /// time offset to the leader in seconds
+    double leaderTimeOffset = 0.0;
+    /// leader which shares its outputs with this instance in the current frame, or nullptr
+    animInstance* sharedLeader = nullptr;
 
     /// clear the object
     void clear() {
         library = nullptr;
         skeleton = nullptr;
+        sequencer.items.Clear();
+        sequencer.mirrorSkeleton = nullptr;
+        rootMotion = glm::vec4(0.0f);
+        rootMotionTime = -1.0;
+        evalSignature = 0;
+        evalFrameIndex = 0;
+        dirty = true;
+        skinInfoIndex = InvalidIndex;
+        lod = 0;
+        baked = false;
+        leaderId = Oryol::Id::InvalidId();
+        leaderTimeOffset = 0.0;
+        sharedLeader = nullptr;
         samples.Reset();
+        fixedSamples.Reset();
         skinMatrices.Reset();
+        hasVelocities = false;
+        velocities.Reset();
     }
 };
 
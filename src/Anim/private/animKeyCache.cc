@@ -0,0 +1,134 @@
+//------------------------------------------------------------------------------
+//  animKeyCache.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "animKeyCache.h"
+#include "Core/Memory/Memory.h"
+
+namespace Oryol {
+namespace _priv {
+
+//------------------------------------------------------------------------------
+animKeyCache::~animKeyCache() {
+    o_assert_dbg(!this->slots && !this->rows);
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::setup(int numFloats) {
+    o_assert_dbg(numFloats >= 0);
+    this->budget = numFloats;
+    this->rowCapacity = 0;
+    this->numSlots = 0;
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::discard() {
+    this->alloc(0);
+    this->budget = 0;
+}
+
+//------------------------------------------------------------------------------
+bool
+animKeyCache::isValid() const {
+    return this->numSlots > 0;
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::alloc(int capacity) {
+    if (this->slots) {
+        Memory::Free(this->slots);
+        this->slots = nullptr;
+    }
+    if (this->rows) {
+        Memory::Free(this->rows);
+        this->rows = nullptr;
+    }
+    this->rowCapacity = 0;
+    this->numSlots = 0;
+    if (capacity > 0) {
+        // number of slots must be a power of 2, and at least 2 so
+        // that the 2 rows of a sample can be cached at the same time
+        int num = 1;
+        while ((num * 2 * capacity) <= this->budget) {
+            num *= 2;
+        }
+        if (num >= 2) {
+            this->rowCapacity = capacity;
+            this->numSlots = num;
+            this->slots = (slot*) Memory::Alloc(num * sizeof(slot));
+            for (int i = 0; i < num; i++) {
+                this->slots[i] = slot();
+            }
+            this->rows = (float*) Memory::Alloc(num * capacity * sizeof(float));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::reserve(int keyStride) {
+    if ((this->budget > 0) && (keyStride > this->rowCapacity)) {
+        this->alloc(keyStride);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::invalidate() {
+    this->generation++;
+}
+
+//------------------------------------------------------------------------------
+int
+animKeyCache::slotIndex(const AnimClip& clip, int keyIndex) const {
+    // consecutive keys of a clip go into consecutive slots
+    uintptr_t h = uintptr_t(&clip);
+    h ^= h >> 7;
+    h *= 0x9E3779B1;
+    return int((h + keyIndex) & (this->numSlots - 1));
+}
+
+//------------------------------------------------------------------------------
+bool
+animKeyCache::isCached(const AnimClip& clip, int keyIndex) const {
+    const slot& s = this->slots[this->slotIndex(clip, keyIndex)];
+    return (s.clip == &clip) && (s.keyIndex == keyIndex) && (s.generation == this->generation);
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::decodeRow(const AnimClip& clip, int keyIndex, float* dst) {
+    const int16_t* src = &(clip.Keys[keyIndex * clip.KeyStride]);
+    for (const auto& curve : clip.Curves) {
+        if (!curve.Static) {
+            for (int i = 0; i < curve.NumValues; i++) {
+                *dst++ = float(*src++) * curve.Magnitude[i];
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+const float*
+animKeyCache::lookup(const AnimClip& clip, int keyIndex) {
+    if ((0 == this->numSlots) || (clip.KeyStride > this->rowCapacity) || clip.Keys.Empty()) {
+        return nullptr;
+    }
+    const int index = this->slotIndex(clip, keyIndex);
+    slot& s = this->slots[index];
+    float* row = this->rows + index * this->rowCapacity;
+    if ((s.clip != &clip) || (s.keyIndex != keyIndex) || (s.generation != this->generation)) {
+        // cache miss, unpack the key row
+        decodeRow(clip, keyIndex, row);
+        s.clip = &clip;
+        s.keyIndex = keyIndex;
+        s.generation = this->generation;
+    }
+    return row;
+}
+
+} // namespace _priv
+} // namespace Oryol
@@ -0,0 +1,63 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::_priv::animKeyCache
+    @ingroup _priv
+    @brief shared cache of decoded (float) key rows
+
+    A direct-mapped cache of unpacked key rows, keyed by clip and key
+    index. With key rates below the frame rate, the same key rows are
+    used for several frames in a row, and instances playing the same
+    clip share rows, so most frames only need the float lerp.
+    Consecutive keys of a clip map to consecutive slots, so the 2 rows
+    needed for sampling don't evict each other. The cache must be
+    invalidated whenever clips are destroyed or keys change.
+*/
+#include "Anim/AnimTypes.h"
+
+namespace Oryol {
+namespace _priv {
+
+class animKeyCache {
+public:
+    /// destructor
+    ~animKeyCache();
+
+    /// setup the cache with a budget in number of floats (0 disables the cache)
+    void setup(int numFloats);
+    /// discard the cache
+    void discard();
+    /// return true if the cache is enabled
+    bool isValid() const;
+    /// make sure rows of keyStride floats fit into a slot (may invalidate)
+    void reserve(int keyStride);
+    /// invalidate all cached rows
+    void invalidate();
+    /// get the decoded key row of a clip, decode on cache miss (nullptr if not cacheable)
+    const float* lookup(const AnimClip& clip, int keyIndex);
+    /// return true if the row returned by lookup() is still cached
+    bool isCached(const AnimClip& clip, int keyIndex) const;
+    /// unpack a key row of a clip into KeyStride floats
+    static void decodeRow(const AnimClip& clip, int keyIndex, float* dst);
+
+private:
+    /// compute the slot index of a key row
+    int slotIndex(const AnimClip& clip, int keyIndex) const;
+    /// (re-)allocate the slots for a row capacity
+    void alloc(int rowCapacity);
+
+    struct slot {
+        const AnimClip* clip = nullptr;
+        int keyIndex = InvalidIndex;
+        uint32_t generation = 0;
+    };
+    int budget = 0;
+    int rowCapacity = 0;
+    int numSlots = 0;
+    uint32_t generation = 1;
+    slot* slots = nullptr;
+    float* rows = nullptr;
+};
+
+} // namespace _priv
+} // namespace Oryol
@@ -3,14 +3,64 @@
 //------------------------------------------------------------------------------
 #include "Pre.h"
 #include "animMgr.h"
+#include "animFixed.h"
 #include "Core/Memory/Memory.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <cstring>
+#include <float.h>
+#include <algorithm>
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#include <xmmintrin.h>
+#define ORYOL_ANIM_STREAM_STORES (1)
+#else
+#define ORYOL_ANIM_STREAM_STORES (0)
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define ORYOL_ANIM_FIXED_SSE2 (1)
+#else
+#define ORYOL_ANIM_FIXED_SSE2 (0)
+#endif
 
 namespace Oryol {
 namespace _priv {
 
+//------------------------------------------------------------------------------
+static bool
+mx_can_stream(const float* dst) {
+    // streaming stores need 16-byte aligned destination
+    #if ORYOL_ANIM_STREAM_STORES
+    return 0 == (uintptr_t(dst) & 15);
+    #else
+    return false;
+    #endif
+}
+
+//------------------------------------------------------------------------------
+static void
+mx_stream(const float* src, float* dst) {
+    // write a transposed 4x3 matrix with non-temporal stores, bypassing the cache
+    #if ORYOL_ANIM_STREAM_STORES
+    _mm_stream_ps(dst + 0, _mm_loadu_ps(src + 0));
+    _mm_stream_ps(dst + 4, _mm_loadu_ps(src + 4));
+    _mm_stream_ps(dst + 8, _mm_loadu_ps(src + 8));
+    #else
+    for (int i = 0; i < 12; i++) {
+        dst[i] = src[i];
+    }
+    #endif
+}
+
+//------------------------------------------------------------------------------
+static void
+mx_stream_fence() {
+    // make streaming stores visible before the skin matrices are consumed
+    #if ORYOL_ANIM_STREAM_STORES
+    _mm_sfence();
+    #endif
+}
+
 //------------------------------------------------------------------------------
 animMgr::~animMgr() {
     o_assert_dbg(!this->isValid);
@@ -29,17 +79,44 @@ animMgr::setup(const AnimSetup& setup) {
     this->instPool.Setup(resTypeInstance, setup.MaxNumInstances);
     this->clipPool.SetFixedCapacity(setup.ClipPoolCapacity);
     this->curvePool.SetFixedCapacity(setup.CurvePoolCapacity);
+    this->clipBlocks.setup(setup.ClipPoolCapacity);
+    this->curveBlocks.setup(setup.CurvePoolCapacity);
     this->matrixPool.SetFixedCapacity(setup.MatrixPoolCapacity);
     this->activeInstances.SetFixedCapacity(setup.MaxNumActiveInstances);
+    this->sortItems.SetFixedCapacity(setup.MaxNumActiveInstances);
+    this->sampleGroupItems.SetFixedCapacity(setup.MaxNumActiveInstances);
+    this->skinGroupInstances.SetFixedCapacity(setup.MaxNumActiveInstances);
+    this->skinInfoInstances.SetFixedCapacity(setup.MaxNumActiveInstances);
+    this->keyCache.setup(setup.KeyCacheCapacity);
+    if (setup.HotKeyPoolCapacity > 0) {
+        this->hotClipCandidates.SetFixedCapacity(setup.ClipPoolCapacity);
+        this->hotClips.SetFixedCapacity(setup.ClipPoolCapacity);
+        this->hotKeyBlocks.setup(setup.HotKeyPoolCapacity);
+        this->hotKeyPool = (float*) Memory::Alloc(setup.HotKeyPoolCapacity * sizeof(float));
+    }
+    this->skinMatrixInfo.DirtyRanges.SetFixedCapacity(setup.MaxNumActiveInstances);
+    if (setup.MinSkinGroupSize > 0) {
+        // world-space bone matrices of all lanes, 12 floats per bone and lane
+        const int scratchSize = AnimConfig::MaxNumSkeletonBones * 12 * maxSkinGroupLanes * sizeof(float);
+        this->skinGroupScratch = (float*) Memory::Alloc(scratchSize);
+    }
     this->skinMatrixInfo.InstanceInfos.SetFixedCapacity(setup.MaxNumActiveInstances);
     this->keyPool = (int16_t*) Memory::Alloc(setup.KeyPoolCapacity * sizeof(int16_t));
     this->samplePool = (float*) Memory::Alloc(setup.SamplePoolCapacity * sizeof(float));
     this->keys = Slice<int16_t>(this->keyPool, setup.KeyPoolCapacity, 0, setup.KeyPoolCapacity);
     this->samples = Slice<float>(this->samplePool, setup.SamplePoolCapacity, 0, setup.SamplePoolCapacity);
+    if (AnimEvalMode::FixedPoint == setup.EvalMode) {
+        // fixed-point samples are kept for skinning, so that they don't need to round-trip through float
+        this->fixedSamplePool = (int32_t*) Memory::Alloc(setup.SamplePoolCapacity * sizeof(int32_t));
+        this->fixedSamples = Slice<int32_t>(this->fixedSamplePool, setup.SamplePoolCapacity, 0, setup.SamplePoolCapacity);
+    }
     this->skinMatrixTableStride = setup.SkinMatrixTableWidth * 4;
     const int skinMatrixPoolNumFloats = this->skinMatrixTableStride * setup.SkinMatrixTableHeight;
     const int skinMatrixPoolSize = skinMatrixPoolNumFloats * sizeof(float);
-    this->skinMatrixPool = (float*) Memory::Alloc(skinMatrixPoolSize);
+    // the skin matrix table starts at a cache line, so that instances
+    // aligned for streaming stores are also cache line aligned in memory
+    this->skinMatrixPoolAlloc = (uint8_t*) Memory::Alloc(skinMatrixPoolSize + skinMatrixAlignment - 1);
+    this->skinMatrixPool = (float*) ((uintptr_t(this->skinMatrixPoolAlloc) + skinMatrixAlignment - 1) & ~uintptr_t(skinMatrixAlignment - 1));
     Memory::Clear(this->skinMatrixPool, skinMatrixPoolSize);
     this->skinMatrixTable = Slice<float>(this->skinMatrixPool, skinMatrixPoolNumFloats);
     this->skinMatrixInfo.SkinMatrixTable = this->skinMatrixTable.begin();
@@ -60,20 +137,82 @@ animMgr::discard() {
     this->libPool.Discard();
     o_assert_dbg(this->clipPool.Empty());
     o_assert_dbg(this->curvePool.Empty());
+    this->clipBlocks.discard();
+    this->curveBlocks.discard();
     o_assert_dbg(this->matrixPool.Empty());
     this->activeInstances.Clear();
+    this->sortItems.Clear();
+    this->sampleGroupItems.Clear();
+    this->skinGroupInstances.Clear();
+    this->skinInfoInstances.Clear();
+    this->keyCache.discard();
+    if (this->sampleWorkers.isValid()) {
+        this->sampleWorkers.discard();
+    }
+    this->hotClipCandidates.Clear();
+    if (this->hotKeyPool) {
+        o_assert_dbg(this->hotClips.Empty());
+        this->hotKeyBlocks.discard();
+        Memory::Free(this->hotKeyPool);
+        this->hotKeyPool = nullptr;
+    }
+    if (this->skinGroupScratch) {
+        Memory::Free(this->skinGroupScratch);
+        this->skinGroupScratch = nullptr;
+    }
     this->keys.Reset();
     this->samples.Reset();
     this->skinMatrixTable.Reset();
-    Memory::Free(this->skinMatrixPool);
+    Memory::Free(this->skinMatrixPoolAlloc);
+    this->skinMatrixPoolAlloc = nullptr;
     this->skinMatrixPool = nullptr;
     Memory::Free(this->keyPool);
     this->keyPool = nullptr;
     Memory::Free(this->samplePool);
     this->samplePool = nullptr;
+    if (this->fixedSamplePool) {
+        this->fixedSamples.Reset();
+        Memory::Free(this->fixedSamplePool);
+        this->fixedSamplePool = nullptr;
+    }
     this->isValid = false;
 }
 
+//------------------------------------------------------------------------------
+template<class TYPE> static int
+allocBlock(animBlockAlloc& blocks, Array<TYPE>& pool, int num) {
+    // allocate a block of items which stays in place until it is freed,
+    // the pool array only grows if the block is appended at the end
+    const int offset = blocks.alloc(num);
+    if (InvalidIndex != offset) {
+        while (pool.Size() < blocks.end()) {
+            pool.Add();
+        }
+    }
+    return offset;
+}
+
+//------------------------------------------------------------------------------
+template<class TYPE> static void
+freeBlock(animBlockAlloc& blocks, Array<TYPE>& pool, const Slice<TYPE>& range) {
+    if (!range.Empty()) {
+        blocks.free(range.Offset(), range.Size());
+        if (pool.Size() > blocks.end()) {
+            pool.EraseRange(blocks.end(), pool.Size() - blocks.end());
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+template<class TYPE> static void
+addGap(Array<animMgr::poolGap>& gaps, const Slice<TYPE>& range) {
+    if (!range.Empty()) {
+        animMgr::poolGap& gap = gaps.Add();
+        gap.offset = range.Offset();
+        gap.size = range.Size();
+    }
+}
+
 //------------------------------------------------------------------------------
 void
 animMgr::destroy(const ResourceLabel& label) {
@@ -95,6 +234,8 @@ animMgr::destroy(const ResourceLabel& label) {
                 break;
         }
     }
+    // remove the pool ranges of all destroyed libraries and skeletons at once
+    this->compactPools();
 }
 
 //------------------------------------------------------------------------------
@@ -113,14 +254,6 @@ animMgr::createLibrary(const AnimLibrarySetup& libSetup) {
     }
 
     // before creating new lib, validate setup params and check against pool limits
-    if ((this->clipPool.Size() + libSetup.Clips.Size()) > this->clipPool.Capacity()) {
-        o_warn("Anim: clip pool exhausted!\n");
-        return Id::InvalidId();
-    }
-    if ((this->curvePool.Size() + libSetup.CurveLayout.Size()) > this->curvePool.Capacity()) {
-        o_warn("Anim: curve pool exhausted!\n");
-        return Id::InvalidId();
-    }
     int libNumKeys = 0;
     for (const auto& clipSetup : libSetup.Clips) {
         if (clipSetup.Curves.Size() != libSetup.CurveLayout.Size()) {
@@ -137,6 +270,19 @@ animMgr::createLibrary(const AnimLibrarySetup& libSetup) {
         o_warn("Anim: key pool exhausted!\n");
         return Id::InvalidId();
     }
+    const int numClips = libSetup.Clips.Size();
+    const int numCurves = numClips * libSetup.CurveLayout.Size();
+    const int clipPoolIndex = allocBlock(this->clipBlocks, this->clipPool, numClips);
+    if (InvalidIndex == clipPoolIndex) {
+        o_warn("Anim: clip pool exhausted!\n");
+        return Id::InvalidId();
+    }
+    const int curvePoolIndex = allocBlock(this->curveBlocks, this->curvePool, numCurves);
+    if (InvalidIndex == curvePoolIndex) {
+        freeBlock(this->clipBlocks, this->clipPool, this->clipPool.MakeSlice(clipPoolIndex, numClips));
+        o_warn("Anim: curve pool exhausted!\n");
+        return Id::InvalidId();
+    }
 
     // create a new lib
     resId = this->libPool.AllocId();
@@ -149,20 +295,84 @@ animMgr::createLibrary(const AnimLibrarySetup& libSetup) {
     for (auto fmt : libSetup.CurveLayout) {
         lib.SampleStride += AnimCurveFormat::Stride(fmt);
     }
-    lib.ClipIndexMap.Reserve(libSetup.Clips.Size());
-    const int curvePoolIndex = this->curvePool.Size();
-    const int clipPoolIndex = this->clipPool.Size();
-    int clipKeyIndex = this->numKeys;
-    for (const auto& clipSetup : libSetup.Clips) {
-        lib.ClipIndexMap.Add(clipSetup.Name, this->clipPool.Size());
-        AnimClip& clip = this->clipPool.Add();
+    if (InvalidIndex != libSetup.RootMotionCurve) {
+        o_assert_range_dbg(libSetup.RootMotionCurve, libSetup.CurveLayout.Size());
+        o_assert_dbg(AnimCurveFormat::Quaternion != libSetup.CurveLayout[libSetup.RootMotionCurve]);
+        lib.RootMotionCurve = libSetup.RootMotionCurve;
+        lib.RootMotionSampleIndex = 0;
+        for (int i = 0; i < libSetup.RootMotionCurve; i++) {
+            lib.RootMotionSampleIndex += AnimCurveFormat::Stride(libSetup.CurveLayout[i]);
+        }
+        lib.RootMotionMask = libSetup.RootMotionMask;
+    }
+    if (libSetup.PoseBasisSize > 0) {
+        if (AnimEvalMode::FixedPoint == this->animSetup.EvalMode) {
+            o_warn("Anim: pose basis compression not supported in fixed-point mode, ignored!\n");
+        }
+        else {
+            lib.PoseBasisSize = libSetup.PoseBasisSize < AnimConfig::MaxPoseBasisSize ? libSetup.PoseBasisSize : AnimConfig::MaxPoseBasisSize;
+        }
+    }
+    lib.Curves = this->curvePool.MakeSlice(curvePoolIndex, numCurves);
+    lib.Clips = this->clipPool.MakeSlice(clipPoolIndex, numClips);
+    this->initClips(&lib, libSetup, this->numKeys);
+    o_assert_dbg(lib.Keys.Size() == libNumKeys);
+    this->numKeys += libNumKeys;
+
+    // initialize clips with their default values
+    /*
+    FIXME FIXME FIXME
+    for (auto& clip : lib.Clips) {
+        for (int row = 0; row < clip.Length; row++) {
+            int offset = row * clip.KeyStride;
+            for (const auto& curve : clip.Curves) {
+                for (int i = 0; i < curve.KeyStride; i++) {
+                    clip.Keys[offset++] = curve.StaticValue[i];
+                }
+            }
+        }
+    }
+    */
+
+    this->initStaticBones(&lib);
+
+    // make room for the library's key rows in the decoded key cache
+    for (const auto& clip : lib.Clips) {
+        this->keyCache.reserve(clip.KeyStride);
+    }
+
+    this->resContainer.registry.Add(libSetup.Locator, resId, this->resContainer.PeekLabel());
+    this->libPool.UpdateState(resId, ResourceState::Valid);
+    return resId;
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::initClips(AnimLibrary* lib, const AnimLibrarySetup& libSetup, int keyIndex) {
+    o_assert_dbg(lib);
+    o_assert_dbg(lib->Clips.Size() == libSetup.Clips.Size());
+    o_assert_dbg(lib->Curves.Size() == (libSetup.Clips.Size() * libSetup.CurveLayout.Size()));
+
+    // the clips and curves already have their place in the clip and curve
+    // pool, all their previous state is overwritten, the clip keys are
+    // packed starting at keyIndex in the key pool
+    const bool fixedPoint = AnimEvalMode::FixedPoint == this->animSetup.EvalMode;
+    lib->ClipIndexMap.Clear();
+    lib->ClipIndexMap.Reserve(libSetup.Clips.Size());
+    int clipKeyIndex = keyIndex;
+    for (int clipIndex = 0; clipIndex < libSetup.Clips.Size(); clipIndex++) {
+        const auto& clipSetup = libSetup.Clips[clipIndex];
+        lib->ClipIndexMap.Add(clipSetup.Name, clipIndex);
+        AnimClip& clip = lib->Clips[clipIndex];
+        clip = AnimClip();
         clip.Name = clipSetup.Name;
         clip.Length = clipSetup.Length;
         clip.KeyDuration = clipSetup.KeyDuration;
-        const int curveIndex = this->curvePool.Size();
+        clip.Curves = lib->Curves.MakeSlice(clipIndex * clipSetup.Curves.Size(), clipSetup.Curves.Size());
         for (int curveIndex = 0; curveIndex < clipSetup.Curves.Size(); curveIndex++) {
             const auto& curveSetup = clipSetup.Curves[curveIndex];
-            AnimCurve& curve = this->curvePool.Add();
+            AnimCurve& curve = clip.Curves[curveIndex];
+            curve = AnimCurve();
             curve.Static = curveSetup.Static;
             curve.Format = libSetup.CurveLayout[curveIndex];
             curve.NumValues = AnimCurveFormat::Stride(curve.Format);
@@ -171,43 +381,171 @@ animMgr::createLibrary(const AnimLibrarySetup& libSetup) {
                 // premultiply magnitude for 16-bit signed unpacking
                 curve.Magnitude[i] = curveSetup.Magnitude[i] / 32767.0f;
             }
+            if (fixedPoint) {
+                for (int i = 0; i < 4; i++) {
+                    float value = curve.StaticValue[i];
+                    float magnitude = curve.Magnitude[i];
+                    if (!animFixed::isValidValue(value) || !animFixed::isValidMagnitude(magnitude)) {
+                        o_warn("Anim: curve value or magnitude out of fixed-point range in clip '%s', clamped!\n", clipSetup.Name.AsCStr());
+                        value = animFixed::clampValue(value);
+                        magnitude = animFixed::clampMagnitude(magnitude);
+                    }
+                    curve.FixedStaticValue[i] = animFixed::fromFloat(value);
+                    curve.FixedMagnitude[i] = animFixed::fromMagnitude(magnitude);
+                }
+            }
             if (!curve.Static) {
                 curve.KeyIndex = clip.KeyStride;
                 curve.KeyStride = AnimCurveFormat::Stride(curve.Format);
                 clip.KeyStride += curve.KeyStride;
             }
         }
-        clip.Curves = this->curvePool.MakeSlice(curveIndex, clipSetup.Curves.Size());
         const int clipNumKeys = clip.KeyStride * clip.Length;
         if (clipNumKeys > 0) {
             clip.Keys = this->keys.MakeSlice(clipKeyIndex, clipNumKeys);
             clipKeyIndex += clipNumKeys;
         }
     }
-    o_assert_dbg(clipKeyIndex == (this->numKeys + libNumKeys));
-    lib.Keys = this->keys.MakeSlice(this->numKeys, libNumKeys);
-    this->numKeys += libNumKeys;
-    lib.Curves = this->curvePool.MakeSlice(curvePoolIndex, libSetup.Clips.Size() * libSetup.CurveLayout.Size());
-    lib.Clips = this->clipPool.MakeSlice(clipPoolIndex, libSetup.Clips.Size());
+    lib->Keys = this->keys.MakeSlice(keyIndex, clipKeyIndex - keyIndex);
 
-    // initialize clips with their default values
-    /*
-    FIXME FIXME FIXME
-    for (auto& clip : lib.Clips) {
-        for (int row = 0; row < clip.Length; row++) {
-            int offset = row * clip.KeyStride;
-            for (const auto& curve : clip.Curves) {
-                for (int i = 0; i < curve.KeyStride; i++) {
-                    clip.Keys[offset++] = curve.StaticValue[i];
+    // allocate the (value, delta) key pairs of clips which opted in, 
+    // they are filled in writeKeys
+    lib->DeltaKeys.Clear();
+    int numDeltaKeys = 0;
+    for (int i = 0; i < libSetup.Clips.Size(); i++) {
+        if (libSetup.Clips[i].DeltaKeys) {
+            numDeltaKeys += lib->Clips[i].Keys.Size() * 2;
+        }
+    }
+    if (numDeltaKeys > 0) {
+        lib->DeltaKeys.SetFixedCapacity(numDeltaKeys);
+        for (int i = 0; i < numDeltaKeys; i++) {
+            lib->DeltaKeys.Add(0.0f);
+        }
+        int deltaKeyIndex = 0;
+        for (int i = 0; i < libSetup.Clips.Size(); i++) {
+            AnimClip& clip = lib->Clips[i];
+            if (libSetup.Clips[i].DeltaKeys && !clip.Keys.Empty()) {
+                clip.DeltaKeys = &(lib->DeltaKeys[deltaKeyIndex]);
+                deltaKeyIndex += clip.Keys.Size() * 2;
+            }
+        }
+    }
+
+    // allocate the reduced-rate LOD keys of clips which opted in,
+    // LOD n has every (1<<n)-th key row, they are filled in writeKeys,
+    // the int16 keys of pose basis libraries are released, so these
+    // can't have LODs
+    lib->LodKeys.Clear();
+    int numLodKeys = 0;
+    for (int i = 0; i < libSetup.Clips.Size(); i++) {
+        const AnimClip& clip = lib->Clips[i];
+        o_assert_range_dbg(libSetup.Clips[i].NumLods, AnimConfig::MaxNumClipLods + 1);
+        if ((libSetup.Clips[i].NumLods > 0) && (lib->PoseBasisSize > 0)) {
+            o_warn("Anim: clip '%s' of pose basis library can't have LODs, ignored!\n", libSetup.Clips[i].Name.AsCStr());
+        }
+        else if (!clip.Keys.Empty()) {
+            for (int lod = 1; lod <= libSetup.Clips[i].NumLods; lod++) {
+                const int step = 1 << lod;
+                numLodKeys += ((clip.Length + step - 1) / step) * clip.KeyStride;
+            }
+        }
+    }
+    if (numLodKeys > 0) {
+        lib->LodKeys.SetFixedCapacity(numLodKeys);
+        for (int i = 0; i < numLodKeys; i++) {
+            lib->LodKeys.Add(0);
+        }
+        int lodKeyIndex = 0;
+        for (int i = 0; i < libSetup.Clips.Size(); i++) {
+            AnimClip& clip = lib->Clips[i];
+            if (!clip.Keys.Empty() && (0 == lib->PoseBasisSize)) {
+                clip.NumLods = libSetup.Clips[i].NumLods;
+                for (int lod = 1; lod <= clip.NumLods; lod++) {
+                    const int step = 1 << lod;
+                    clip.LodKeys[lod - 1] = &(lib->LodKeys[lodKeyIndex]);
+                    lodKeyIndex += ((clip.Length + step - 1) / step) * clip.KeyStride;
                 }
             }
         }
+        o_assert_dbg(lodKeyIndex == numLodKeys);
     }
-    */
+}
 
-    this->resContainer.registry.Add(libSetup.Locator, resId, this->resContainer.PeekLabel());
-    this->libPool.UpdateState(resId, ResourceState::Valid);
-    return resId;
+//------------------------------------------------------------------------------
+bool
+animMgr::reloadLibrary(AnimLibrary* lib, const AnimLibrarySetup& libSetup, const uint8_t* ptr, int numBytes) {
+    o_assert_dbg(this->isValid);
+    o_assert_dbg(lib && ptr && numBytes > 0);
+
+    // instances address clips by index and samples by the curve layout,
+    // so these must not change for an in-place reload
+    bool compatible = (libSetup.Clips.Size() == lib->Clips.Size()) &&
+                      (libSetup.CurveLayout.Size() == lib->CurveLayout.Size()) &&
+                      (libSetup.RootMotionCurve == lib->RootMotionCurve);
+    for (int i = 0; compatible && (i < libSetup.CurveLayout.Size()); i++) {
+        compatible = libSetup.CurveLayout[i] == lib->CurveLayout[i];
+    }
+    int libNumKeys = 0;
+    for (const auto& clipSetup : libSetup.Clips) {
+        if (clipSetup.Curves.Size() != libSetup.CurveLayout.Size()) {
+            compatible = false;
+            break;
+        }
+        for (int i = 0; i < clipSetup.Curves.Size(); i++) {
+            if (!clipSetup.Curves[i].Static) {
+                libNumKeys += clipSetup.Length * AnimCurveFormat::Stride(libSetup.CurveLayout[i]);
+            }
+        }
+    }
+    if (!compatible) {
+        o_warn("Anim: incompatible layout for reload of library '%s'!\n", lib->Locator.Location().AsCStr());
+        return false;
+    }
+    if ((libNumKeys * int(sizeof(int16_t))) != numBytes) {
+        o_warn("Anim: key data size mismatch for reload of library '%s'!\n", lib->Locator.Location().AsCStr());
+        return false;
+    }
+    if ((this->numKeys - lib->Keys.Size() + libNumKeys) > this->keys.Size()) {
+        o_warn("Anim: key pool exhausted!\n");
+        return false;
+    }
+
+    // reuse the library's key range if the new keys fit and release
+    // the unused rest, otherwise (or if the keys had been released
+    // for a pose basis) append a new key range to the key pool
+    Slice<int16_t> oldKeys = lib->Keys;
+    this->resetHotClips(lib);
+    lib->Keys.Reset();
+    for (auto& clip : lib->Clips) {
+        clip.Keys.Reset();
+    }
+    int keyIndex = 0;
+    if ((libNumKeys <= oldKeys.Size()) && !oldKeys.Empty()) {
+        keyIndex = oldKeys.Offset();
+        if (libNumKeys < oldKeys.Size()) {
+            this->removeKeys(oldKeys.MakeSlice(libNumKeys, oldKeys.Size() - libNumKeys));
+        }
+    }
+    else {
+        this->removeKeys(oldKeys);
+        keyIndex = this->numKeys;
+        this->numKeys += libNumKeys;
+    }
+
+    // the pose basis is rebuilt from the new keys with the original basis size
+    lib->PoseBasis.Clear();
+    lib->PoseCoeffs.Clear();
+    lib->BakedClips.Clear();
+    lib->RootMotionMask = libSetup.RootMotionMask;
+    this->initClips(lib, libSetup, keyIndex);
+    o_assert_dbg(lib->Keys.Size() == libNumKeys);
+    this->initStaticBones(lib);
+    for (const auto& clip : lib->Clips) {
+        this->keyCache.reserve(clip.KeyStride);
+    }
+    this->writeKeys(lib, ptr, numBytes);
+    return true;
 }
 
 //------------------------------------------------------------------------------
@@ -223,10 +561,13 @@ void
 animMgr::destroyLibrary(const Id& id) {
     AnimLibrary* lib = this->libPool.Lookup(id);
     if (lib) {
-        this->removeClips(lib->Clips);
-        this->removeCurves(lib->Curves);
-        this->removeKeys(lib->Keys);
+        this->resetHotClips(lib);
+        freeBlock(this->clipBlocks, this->clipPool, lib->Clips);
+        freeBlock(this->curveBlocks, this->curvePool, lib->Curves);
+        addGap(this->keyGaps, lib->Keys);
         lib->clear();
+        // the freed clips may be reused by another library
+        this->keyCache.invalidate();
     }
     this->libPool.Unassign(id);
 }
@@ -269,6 +610,27 @@ animMgr::createSkeleton(const AnimSkeletonSetup& setup) {
     for (int i = 0; i < skel.NumBones; i++) {
         skel.ParentIndices[i] = setup.Bones[i].ParentIndex;
     }
+    if (AnimEvalMode::FixedPoint == this->animSetup.EvalMode) {
+        // convert the inverse bind pose once instead of every frame
+        skel.FixedInvBindPose.Reserve(skel.NumBones * 12);
+        const float* invBindPose = &(skel.InvBindPose[0][0][0]);
+        for (int i = 0; i < skel.NumBones * 12; i++) {
+            skel.FixedInvBindPose.Add(animFixed::fromFloat(invBindPose[i]));
+        }
+    }
+    if (InvalidIndex != setup.MirrorAxis) {
+        o_assert_range_dbg(setup.MirrorAxis, 3);
+        skel.MirrorAxis = setup.MirrorAxis;
+        for (int i = 0; i < skel.NumBones; i++) {
+            const int mirrorIndex = setup.Bones[i].MirrorIndex;
+            skel.MirrorIndices[i] = (InvalidIndex == mirrorIndex) ? i : mirrorIndex;
+        }
+        // the mirror map must consist of bone pairs
+        for (int i = 0; i < skel.NumBones; i++) {
+            o_assert_range_dbg(skel.MirrorIndices[i], skel.NumBones);
+            o_assert_dbg(skel.MirrorIndices[skel.MirrorIndices[i]] == i);
+        }
+    }
 
     // register the new resource, and done
     this->resContainer.registry.Add(setup.Locator, resId, this->resContainer.PeekLabel());
@@ -289,7 +651,7 @@ void
 animMgr::destroySkeleton(const Id& id) {
     AnimSkeleton* skel = this->skelPool.Lookup(id);
     if (skel) {
-        this->removeMatrices(skel->Matrices);
+        addGap(this->matrixGaps, skel->Matrices);
         skel->clear();
     }
     this->skelPool.Unassign(id);
@@ -309,11 +671,58 @@ animMgr::createInstance(const AnimInstanceSetup& setup) {
         inst.skeleton = this->lookupSkeleton(setup.Skeleton);
         o_assert_dbg(inst.skeleton);
     }
+    inst.hasVelocities = setup.Velocities;
+    if (inst.skeleton && (InvalidIndex != inst.skeleton->MirrorAxis)) {
+        inst.sequencer.mirrorSkeleton = inst.skeleton;
+    }
+    if (setup.Leader.IsValid()) {
+        // the leader's anim jobs address the clips of its library
+        const animInstance* leader = this->instPool.Lookup(setup.Leader);
+        if (leader && (leader->library == inst.library)) {
+            inst.leaderId = setup.Leader;
+            inst.leaderTimeOffset = setup.LeaderTimeOffset;
+        }
+        else {
+            o_warn("Anim: leader instance doesn't exist or uses a different library, ignored!\n");
+        }
+    }
     this->resContainer.registry.Add(Locator::NonShared(), resId, this->resContainer.PeekLabel());
     this->instPool.UpdateState(resId, ResourceState::Valid);
     return resId;
 }
 
+//------------------------------------------------------------------------------
+int
+animMgr::cloneInstances(const animInstance* src, int num, Id* outIds) {
+    o_assert_dbg(this->isValid);
+    o_assert_dbg(src && src->library && outIds);
+
+    // clones share library and skeleton, and start with a copy of the
+    // source's anim jobs, they get fresh per-frame and root motion state
+    const int numFree = this->instPool.QueryPoolInfo().NumFreeSlots;
+    if (num > numFree) {
+        o_warn("Anim: instance pool exhausted!\n");
+        num = numFree;
+    }
+    const ResourceLabel label = this->resContainer.PeekLabel();
+    for (int i = 0; i < num; i++) {
+        Id resId = this->instPool.AllocId();
+        animInstance& inst = this->instPool.Assign(resId, ResourceState::Setup);
+        o_assert_dbg((inst.library == nullptr) && (inst.skeleton == nullptr));
+        inst.library = src->library;
+        inst.skeleton = src->skeleton;
+        inst.sequencer.items = src->sequencer.items;
+        inst.sequencer.mirrorSkeleton = src->sequencer.mirrorSkeleton;
+        inst.hasVelocities = src->hasVelocities;
+        inst.leaderId = src->leaderId;
+        inst.leaderTimeOffset = src->leaderTimeOffset;
+        this->resContainer.registry.Add(Locator::NonShared(), resId, label);
+        this->instPool.UpdateState(resId, ResourceState::Valid);
+        outIds[i] = resId;
+    }
+    return num;
+}
+
 //------------------------------------------------------------------------------
 animInstance*
 animMgr::lookupInstance(const Id& resId) {
@@ -336,130 +745,774 @@ animMgr::destroyInstance(const Id& id) {
 void
 animMgr::removeKeys(Slice<int16_t> range) {
     o_assert_dbg(this->keyPool);
-    if (range.Empty()) {
+    addGap(this->keyGaps, range);
+    this->compactPools();
+}
+
+//------------------------------------------------------------------------------
+template<class TYPE> static int
+compactItems(TYPE* items, int num, Array<animMgr::poolGap>& gaps) {
+    // sort the gaps, compute their accumulated size, and move the items
+    // between gaps down in a single pass, return the new number of items
+    std::sort(gaps.begin(), gaps.end(), [](const animMgr::poolGap& a, const animMgr::poolGap& b) {
+        return a.offset < b.offset;
+    });
+    int shift = 0;
+    for (int i = 0; i < gaps.Size(); i++) {
+        animMgr::poolGap& gap = gaps[i];
+        o_assert_dbg((0 == i) || ((gaps[i-1].offset + gaps[i-1].size) <= gap.offset));
+        shift += gap.size;
+        gap.shift = shift;
+        const int srcEnd = (i + 1) < gaps.Size() ? gaps[i+1].offset : num;
+        for (int src = gap.offset + gap.size; src < srcEnd; src++) {
+            items[src - shift] = items[src];
+        }
+    }
+    return num - shift;
+}
+
+//------------------------------------------------------------------------------
+template<class POOL, class TYPE> static void
+moveSlice(POOL& pool, const Array<animMgr::poolGap>& gaps, Slice<TYPE>& slice) {
+    // move an array view down by the size of all gaps before it (gaps must be sorted)
+    if (slice.Empty()) {
         return;
     }
-    const int numKeysToMove = this->numKeys - (range.Offset() + range.Size());
-    if (numKeysToMove > 0) {
-        Memory::Move(range.end(), (void*)range.begin(), numKeysToMove * sizeof(float)); 
+    int lo = 0;
+    int hi = gaps.Size();
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (gaps[mid].offset < slice.Offset()) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
     }
-    this->numKeys -= range.Size();
-    o_assert_dbg(this->numKeys >= 0);
+    const int shift = lo > 0 ? gaps[lo - 1].shift : 0;
+    slice = pool.MakeSlice(slice.Offset() - shift, slice.Size());
+}
 
-    // fix the key array views in libs and clips
-    for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->libPool.LastAllocSlot; slotIndex++) {
-        AnimLibrary& lib = this->libPool.slots[slotIndex];
-        if (lib.Id.IsValid()) {
-            lib.Keys.FillGap(range.Offset(), range.Size());
+//------------------------------------------------------------------------------
+void
+animMgr::compactPools() {
+    o_assert_dbg(this->isValid);
+    if (!this->keyGaps.Empty()) {
+        this->numKeys = compactItems(this->keyPool, this->numKeys, this->keyGaps);
+        o_assert_dbg(this->numKeys >= 0);
+        for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->libPool.LastAllocSlot; slotIndex++) {
+            AnimLibrary& lib = this->libPool.slots[slotIndex];
+            if (lib.Id.IsValid()) {
+                moveSlice(this->keys, this->keyGaps, lib.Keys);
+                for (auto& clip : lib.Clips) {
+                    moveSlice(this->keys, this->keyGaps, clip.Keys);
+                }
+            }
         }
+        this->keyGaps.Clear();
     }
-    for (auto& clip : this->clipPool) {
-        clip.Keys.FillGap(range.Offset(), range.Size());
+    if (!this->matrixGaps.Empty()) {
+        const int num = compactItems(this->matrixPool.begin(), this->matrixPool.Size(), this->matrixGaps);
+        this->matrixPool.EraseRange(num, this->matrixPool.Size() - num);
+        for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->skelPool.LastAllocSlot; slotIndex++) {
+            AnimSkeleton& skel = this->skelPool.slots[slotIndex];
+            if (skel.Id.IsValid()) {
+                moveSlice(this->matrixPool, this->matrixGaps, skel.Matrices);
+                skel.BindPose = skel.Matrices.MakeSlice(0, skel.NumBones);
+                skel.InvBindPose = skel.Matrices.MakeSlice(skel.NumBones, skel.NumBones);
+            }
+        }
+        this->matrixGaps.Clear();
     }
 }
 
 //------------------------------------------------------------------------------
 void
-animMgr::removeCurves(Slice<AnimCurve> range) {
-    this->curvePool.EraseRange(range.Offset(), range.Size()); 
-
-    // fix the curve array views in libs and clips
-    for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->libPool.LastAllocSlot; slotIndex++) {
-        AnimLibrary& lib = this->libPool.slots[slotIndex];
-        if (lib.Id.IsValid()) {
-            lib.Curves.FillGap(range.Offset(), range.Size());
-        }
+animMgr::writeKeys(AnimLibrary* lib, const uint8_t* ptr, int numBytes) {
+    o_assert_dbg(lib && ptr && numBytes > 0);
+    if (!lib->PoseCoeffs.Empty()) {
+        o_warn("Anim: keys of pose basis library '%s' can only be written once!\n", lib->Locator.Location().AsCStr());
+        return;
+    }
+    o_assert_dbg(lib->Keys.Size()*sizeof(int16_t) == numBytes);
+    Memory::Copy(ptr, lib->Keys.begin(), numBytes);
+    this->initRootMotion(lib);
+    this->initDeltaKeys(lib);
+    this->initLodKeys(lib);
+    // baked skin matrices are outdated with the new keys
+    for (auto& clip : lib->Clips) {
+        clip.BakedIndex = InvalidIndex;
     }
-    for (auto& clip : this->clipPool) {
-        clip.Curves.FillGap(range.Offset(), range.Size());
+    lib->BakedClips.Clear();
+    if (lib->PoseBasisSize > 0) {
+        this->initPoseBasis(lib);
     }
+    this->keysVersion++;
+    this->keyCache.invalidate();
+    this->resetHotClips(lib);
 }
 
 //------------------------------------------------------------------------------
 void
-animMgr::removeClips(Slice<AnimClip> range) {
-    this->clipPool.EraseRange(range.Offset(), range.Size());
-
-    // fix the clip array views in libs
-    for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->libPool.LastAllocSlot; slotIndex++) {
-        AnimLibrary& lib = this->libPool.slots[slotIndex];
-        if (lib.Id.IsValid()) {
-            lib.Clips.FillGap(range.Offset(), range.Size());
+animMgr::initDeltaKeys(AnimLibrary* lib) {
+    o_assert_dbg(lib);
+    // for each key row, store the unpacked value and the delta to the
+    // next key's value (the same key1 as used for sampling, which wraps
+    // around at the end of the clip), sampling is then value + delta * keyPos
+    float row0[AnimConfig::MaxNumCurvesInClip * 4];
+    float row1[AnimConfig::MaxNumCurvesInClip * 4];
+    for (const auto& clip : lib->Clips) {
+        if (!clip.DeltaKeys) {
+            continue;
+        }
+        float* dst = (float*) clip.DeltaKeys;
+        for (int key0 = 0; key0 < clip.Length; key0++) {
+            const int key1 = (key0 + 1) % clip.Length;
+            animKeyCache::decodeRow(clip, key0, row0);
+            animKeyCache::decodeRow(clip, key1, row1);
+            for (int i = 0; i < clip.KeyStride; i++) {
+                *dst++ = row0[i];
+                *dst++ = row1[i] - row0[i];
+            }
         }
     }
 }
 
 //------------------------------------------------------------------------------
 void
-animMgr::removeMatrices(Slice<glm::mat4x3> range) {
-    this->matrixPool.EraseRange(range.Offset(), range.Size());
-
-    // fix the skeleton matrix slices
-    for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->skelPool.LastAllocSlot; slotIndex++) {
-        AnimSkeleton& skel = this->skelPool.slots[slotIndex];
-        if (skel.Id.IsValid()) {
-            skel.BindPose.FillGap(range.Offset(), range.Size());
-            skel.InvBindPose.FillGap(range.Offset(), range.Size());
+animMgr::initLodKeys(AnimLibrary* lib) {
+    o_assert_dbg(lib);
+    // the LOD key rows are copies of every (1<<lod)-th original key
+    // row, so the LOD passes exactly through the original keys it
+    // keeps, the sampler wraps the last LOD key back to the first
+    for (const auto& clip : lib->Clips) {
+        for (int lod = 1; lod <= clip.NumLods; lod++) {
+            const int step = 1 << lod;
+            const int lodLength = (clip.Length + step - 1) / step;
+            int16_t* dst = (int16_t*) clip.LodKeys[lod - 1];
+            for (int lodKey = 0; lodKey < lodLength; lodKey++) {
+                const int16_t* src = &(clip.Keys[lodKey * step * clip.KeyStride]);
+                Memory::Copy(src, dst, clip.KeyStride * sizeof(int16_t));
+                dst += clip.KeyStride;
+            }
         }
     }
 }
 
 //------------------------------------------------------------------------------
-void
-animMgr::writeKeys(AnimLibrary* lib, const uint8_t* ptr, int numBytes) {
-    o_assert_dbg(lib && ptr && numBytes > 0);
-    o_assert_dbg(lib->Keys.Size()*sizeof(int16_t) == numBytes);
-    Memory::Copy(ptr, lib->Keys.begin(), numBytes);
+static void
+decodePose(const AnimClip& clip, int keyIndex, float* row, float* dst) {
+    // decode a key row into a complete pose in sample layout
+    if (!clip.Keys.Empty()) {
+        animKeyCache::decodeRow(clip, keyIndex, row);
+    }
+    for (const auto& curve : clip.Curves) {
+        for (int i = 0; i < curve.NumValues; i++) {
+            *dst++ = curve.Static ? curve.StaticValue[i] : row[curve.KeyIndex + i];
+        }
+    }
 }
 
 //------------------------------------------------------------------------------
-void
-animMgr::newFrame() {
-    o_assert_dbg(!this->inFrame);
-    for (animInstance* inst : this->activeInstances) {
-        inst->samples.Reset();
-        inst->skinMatrices.Reset();
+static void
+orthonormalize(float* vecs, int num, int dim) {
+    // Gram-Schmidt on num vectors of size dim (with 2 projection passes
+    // for numerical stability), vectors which are (almost) linearly 
+    // dependent on the previous vectors are set to zero
+    for (int k = 0; k < num; k++) {
+        float* v = vecs + k * dim;
+        double len0 = 0.0;
+        for (int i = 0; i < dim; i++) {
+            len0 += double(v[i]) * double(v[i]);
+        }
+        for (int pass = 0; pass < 2; pass++) {
+            for (int j = 0; j < k; j++) {
+                const float* u = vecs + j * dim;
+                double dot = 0.0;
+                for (int i = 0; i < dim; i++) {
+                    dot += double(v[i]) * double(u[i]);
+                }
+                for (int i = 0; i < dim; i++) {
+                    v[i] = float(double(v[i]) - dot * double(u[i]));
+                }
+            }
+        }
+        double len = 0.0;
+        for (int i = 0; i < dim; i++) {
+            len += double(v[i]) * double(v[i]);
+        }
+        const float s = (len > (len0 * 1.0e-8)) && (len > 0.0) ? float(1.0 / sqrt(len)) : 0.0f;
+        for (int i = 0; i < dim; i++) {
+            v[i] *= s;
+        }
     }
-    this->activeInstances.Clear();
-    this->numSamples = 0;
-    this->curSkinMatrixTableX = 0;
-    this->curSkinMatrixTableY = 0;
-    this->inFrame = true;
-    this->skinMatrixInfo.SkinMatrixTableByteSize = 0;
-    this->skinMatrixInfo.InstanceInfos.Clear();
 }
 
 //------------------------------------------------------------------------------
-bool
-animMgr::addActiveInstance(animInstance* inst) {
-    o_assert_dbg(inst && inst->library);
-    o_assert_dbg(this->inFrame);
-    
-    // check if resource limits are reached for this frame
-    if (this->activeInstances.Size() == this->activeInstances.Capacity()) {
-        // MaxNumActiveInstances reached
-        return false;
+void
+animMgr::initPoseBasis(AnimLibrary* lib) {
+    o_assert_dbg(lib && (lib->PoseBasisSize > 0));
+    // Compute a pose basis from the principal components of all key
+    // poses in the library (normalized per sample value so that large
+    // translations don't dominate rotations). The components are found
+    // with a block power iteration, which only needs to stream over the
+    // keys instead of building the covariance matrix. Afterwards each
+    // key is replaced by its coefficients, and the int16 keys are released.
+    const int dim = lib->SampleStride;
+    int numCoeffs = lib->PoseBasisSize < dim ? lib->PoseBasisSize : dim;
+    lib->PoseBasisSize = numCoeffs;
+    float row[AnimConfig::MaxNumCurvesInClip * 4];
+    Array<float> pose, mean, scale, basis, accum;
+    pose.SetFixedCapacity(dim);
+    mean.SetFixedCapacity(dim);
+    scale.SetFixedCapacity(dim);
+    for (int i = 0; i < dim; i++) {
+        pose.Add(0.0f);
+        mean.Add(0.0f);
+        scale.Add(0.0f);
     }
-    if ((this->numSamples + inst->library->SampleStride) > this->samples.Size()) {
-        // no more room in samples pool
-        return false;
+    basis.SetFixedCapacity(numCoeffs * dim);
+    accum.SetFixedCapacity(numCoeffs * dim);
+    for (int i = 0; i < numCoeffs * dim; i++) {
+        basis.Add(0.0f);
+        accum.Add(0.0f);
     }
-    if (inst->skeleton) {
-        if (((this->curSkinMatrixTableX + (inst->skeleton->NumBones*3)) > this->animSetup.SkinMatrixTableWidth) &&
-            ((this->curSkinMatrixTableY + 1) > this->animSetup.SkinMatrixTableHeight))
-        {
-            // not enough room in the skin matrix table
-            return false;
+
+    // mean and standard deviation of each sample value
+    int numPoses = 0;
+    for (const auto& clip : lib->Clips) {
+        for (int key = 0; key < clip.Length; key++) {
+            decodePose(clip, key, row, pose.begin());
+            for (int i = 0; i < dim; i++) {
+                mean[i] += pose[i];
+                scale[i] += pose[i] * pose[i];
+            }
+            numPoses++;
         }
     }
-    this->activeInstances.Add(inst);
+    const float invNumPoses = numPoses > 0 ? 1.0f / float(numPoses) : 0.0f;
+    for (int i = 0; i < dim; i++) {
+        mean[i] *= invNumPoses;
+        const float var = scale[i] * invNumPoses - mean[i] * mean[i];
+        scale[i] = var > 1.0e-12f ? sqrtf(var) : 1.0f;
+    }
+    auto normalizedPose = [&pose, &mean, &scale, &row, dim](const AnimClip& clip, int key) {
+        decodePose(clip, key, row, pose.begin());
+        for (int i = 0; i < dim; i++) {
+            pose[i] = (pose[i] - mean[i]) / scale[i];
+        }
+    };
 
-    // assign the samples slice
-    inst->samples = this->samples.MakeSlice(this->numSamples, inst->library->SampleStride);
-    this->numSamples += inst->library->SampleStride;
+    // block power iteration from a deterministic start basis
+    uint32_t rnd = 0x12345678;
+    for (float& f : basis) {
+        rnd = rnd * 1664525 + 1013904223;
+        f = float(rnd >> 8) / float(1<<24) - 0.5f;
+    }
+    orthonormalize(basis.begin(), numCoeffs, dim);
+    float coeffs[AnimConfig::MaxPoseBasisSize];
+    for (int iter = 0; iter < poseBasisIterations; iter++) {
+        Memory::Clear(accum.begin(), accum.Size() * sizeof(float));
+        for (const auto& clip : lib->Clips) {
+            for (int key = 0; key < clip.Length; key++) {
+                normalizedPose(clip, key);
+                for (int k = 0; k < numCoeffs; k++) {
+                    const float* b = &basis[k * dim];
+                    float c = 0.0f;
+                    for (int i = 0; i < dim; i++) {
+                        c += b[i] * pose[i];
+                    }
+                    float* a = &accum[k * dim];
+                    for (int i = 0; i < dim; i++) {
+                        a[i] += c * pose[i];
+                    }
+                }
+            }
+        }
+        orthonormalize(accum.begin(), numCoeffs, dim);
+        basis = accum;
+    }
 
-    // assign the skin matrix slice
-    if (inst->skeleton) {
+    // project the keys onto the basis
+    lib->PoseCoeffs.Clear();
+    lib->PoseCoeffs.SetFixedCapacity(numPoses * numCoeffs);
+    for (auto& clip : lib->Clips) {
+        for (int key = 0; key < clip.Length; key++) {
+            normalizedPose(clip, key);
+            for (int k = 0; k < numCoeffs; k++) {
+                const float* b = &basis[k * dim];
+                coeffs[k] = 0.0f;
+                for (int i = 0; i < dim; i++) {
+                    coeffs[k] += b[i] * pose[i];
+                }
+                lib->PoseCoeffs.Add(coeffs[k]);
+            }
+        }
+    }
+
+    // store the mean and the de-normalized basis vectors
+    lib->PoseBasis.Clear();
+    lib->PoseBasis.SetFixedCapacity((numCoeffs + 1) * dim);
+    for (int i = 0; i < dim; i++) {
+        lib->PoseBasis.Add(mean[i]);
+    }
+    for (int k = 0; k < numCoeffs; k++) {
+        for (int i = 0; i < dim; i++) {
+            lib->PoseBasis.Add(basis[k * dim + i] * scale[i]);
+        }
+    }
+    int coeffIndex = 0;
+    for (auto& clip : lib->Clips) {
+        clip.PoseBasisSize = numCoeffs;
+        clip.PoseBasis = lib->PoseBasis.begin();
+        clip.PoseCoeffs = clip.Length > 0 ? &(lib->PoseCoeffs[coeffIndex]) : nullptr;
+        coeffIndex += clip.Length * numCoeffs;
+    }
+
+    // release the int16 keys, this moves the keys of other libraries
+    this->removeKeys(lib->Keys);
+    lib->Keys.Reset();
+    for (auto& clip : lib->Clips) {
+        clip.Keys.Reset();
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::initRootMotion(AnimLibrary* lib) {
+    o_assert_dbg(lib);
+    lib->RootMotion.Clear();
+    lib->FixedRootMotion.Clear();
+    if (InvalidIndex == lib->RootMotionCurve) {
+        return;
+    }
+    const bool fixedPoint = AnimEvalMode::FixedPoint == this->animSetup.EvalMode;
+    // for each clip, build a table with the first key value of the root
+    // curve (the value which replaces the root curve in the pose), and
+    // the accumulated root displacement at each key; to make the table
+    // loop-aware, the displacement from the last to the first key
+    // isn't the actual (backward) jump, but the average displacement 
+    // between keys
+    for (AnimClip& clip : lib->Clips) {
+        const AnimCurve& curve = clip.Curves[lib->RootMotionCurve];
+        if (curve.Static || (0 == clip.Length)) {
+            clip.RootMotionIndex = InvalidIndex;
+            continue;
+        }
+        clip.RootMotionIndex = lib->RootMotion.Size();
+        auto key = [&clip, &curve](int keyIndex) -> glm::vec4 {
+            glm::vec4 v(0.0f);
+            const int16_t* src = &(clip.Keys[keyIndex * clip.KeyStride + curve.KeyIndex]);
+            for (int i = 0; i < curve.NumValues; i++) {
+                v[i] = float(src[i]) * curve.Magnitude[i];
+            }
+            return v;
+        };
+        const glm::vec4 first = key(0);
+        lib->RootMotion.Add(first);
+        glm::vec4 accum(0.0f);
+        lib->RootMotion.Add(accum);
+        for (int keyIndex = 1; keyIndex < clip.Length; keyIndex++) {
+            accum = key(keyIndex) - first;
+            lib->RootMotion.Add(accum);
+        }
+        if (clip.Length > 1) {
+            accum += accum * (1.0f / float(clip.Length - 1));
+        }
+        lib->RootMotion.Add(accum);
+        if (fixedPoint) {
+            this->initFixedRootMotion(lib, clip);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::initFixedRootMotion(AnimLibrary* lib, const AnimClip& clip) {
+    // same table as in initRootMotion, but with Q16.16 values unpacked
+    // the same way as by the fixed-point evaluation, so that the entries
+    // of a clip start at RootMotionIndex*4 in FixedRootMotion
+    const AnimCurve& curve = clip.Curves[lib->RootMotionCurve];
+    o_assert_dbg(lib->FixedRootMotion.Size() == (clip.RootMotionIndex * 4));
+    auto key = [&clip, &curve](int keyIndex, int i) -> int32_t {
+        if (i >= curve.NumValues) {
+            return 0;
+        }
+        const int16_t k = clip.Keys[keyIndex * clip.KeyStride + curve.KeyIndex + i];
+        return animFixed::unpackLerp(k, k, 0, curve.FixedMagnitude[i]);
+    };
+    for (int i = 0; i < 4; i++) {
+        lib->FixedRootMotion.Add(key(0, i));
+    }
+    int32_t accum[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 4; i++) {
+        lib->FixedRootMotion.Add(accum[i]);
+    }
+    for (int keyIndex = 1; keyIndex < clip.Length; keyIndex++) {
+        for (int i = 0; i < 4; i++) {
+            accum[i] = key(keyIndex, i) - key(0, i);
+            lib->FixedRootMotion.Add(accum[i]);
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        if (clip.Length > 1) {
+            accum[i] += accum[i] / (clip.Length - 1);
+        }
+        lib->FixedRootMotion.Add(accum[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+animMgr::bakeSkinMatrices(AnimLibrary* lib, int clipIndex, AnimSkeleton* skel) {
+    o_assert_dbg(lib && skel);
+    o_assert_range_dbg(clipIndex, lib->Clips.Size());
+    AnimClip& clip = lib->Clips[clipIndex];
+    if ((skel->NumBones * 10) > lib->SampleStride) {
+        o_warn("Anim: can't bake clip '%s', library doesn't match skeleton!\n", clip.Name.AsCStr());
+        return false;
+    }
+    if (0 == clip.Length) {
+        o_warn("Anim: can't bake clip '%s', clip has no keys!\n", clip.Name.AsCStr());
+        return false;
+    }
+
+    // evaluate and skin each key of the clip through a temporary
+    // instance which plays the clip, so that baked matrices are 
+    // exactly what the regular evaluation produces at key times
+    animInstance inst;
+    inst.library = lib;
+    inst.skeleton = skel;
+    AnimJob job;
+    job.ClipIndex = clipIndex;
+    inst.sequencer.add(this->curTime, 0, job, clip.Length * clip.KeyDuration);
+    const int numElements = skel->NumBones * 12;
+    Array<float> smp;
+    smp.SetFixedCapacity(lib->SampleStride);
+    for (int i = 0; i < lib->SampleStride; i++) {
+        smp.Add(0.0f);
+    }
+    Array<float> matrices;
+    matrices.SetFixedCapacity(clip.Length * numElements);
+    for (int i = 0; i < clip.Length * numElements; i++) {
+        matrices.Add(0.0f);
+    }
+    inst.samples = smp.MakeSlice();
+    for (int key = 0; key < clip.Length; key++) {
+        const double keyTime = this->curTime + key * clip.KeyDuration;
+        inst.sequencer.eval(lib, keyTime, smp.begin(), smp.Size());
+        if (InvalidIndex != lib->RootMotionCurve) {
+            inst.sequencer.evalRootMotion(lib, keyTime, keyTime, smp.begin(), nullptr, inst.rootMotion);
+        }
+        inst.skinMatrices = matrices.MakeSlice(key * numElements, numElements);
+        this->genSkinMatrices(&inst);
+    }
+    if (this->animSetup.StreamSkinMatrices) {
+        mx_stream_fence();
+    }
+
+    // quantize each matrix element over all keys to 16 bits
+    AnimBakedClip* baked;
+    if (InvalidIndex == clip.BakedIndex) {
+        clip.BakedIndex = lib->BakedClips.Size();
+        baked = &lib->BakedClips.Add();
+    }
+    else {
+        baked = &lib->BakedClips[clip.BakedIndex];
+    }
+    baked->Skeleton = skel->Id;
+    baked->NumBones = skel->NumBones;
+    baked->Keys.Clear();
+    baked->Offset.Clear();
+    baked->Scale.Clear();
+    baked->Keys.SetFixedCapacity(clip.Length * numElements);
+    baked->Offset.SetFixedCapacity(numElements);
+    baked->Scale.SetFixedCapacity(numElements);
+    for (int i = 0; i < numElements; i++) {
+        float minVal = matrices[i];
+        float maxVal = matrices[i];
+        for (int key = 1; key < clip.Length; key++) {
+            const float v = matrices[key * numElements + i];
+            minVal = v < minVal ? v : minVal;
+            maxVal = v > maxVal ? v : maxVal;
+        }
+        const float scale = (maxVal - minVal) / 65535.0f;
+        baked->Scale.Add(scale);
+        baked->Offset.Add(minVal + 32768.0f * scale);
+    }
+    for (int key = 0; key < clip.Length; key++) {
+        for (int i = 0; i < numElements; i++) {
+            const float scale = baked->Scale[i];
+            int q = 0;
+            if (scale > 0.0f) {
+                q = int(floorf((matrices[key * numElements + i] - baked->Offset[i]) / scale + 0.5f));
+                q = q < -32768 ? -32768 : (q > 32767 ? 32767 : q);
+            }
+            baked->Keys.Add(int16_t(q));
+        }
+    }
+    this->keysVersion++;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+namespace {
+struct sampleClipJob {
+    const AnimClip* clip;
+    const double* times;
+    float* out;
+    int stride;
+    int numTimes;
+    int chunkSize;
+    bool fixedPoint;
+};
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleClipChunk(void* userData, int chunkIndex) {
+    const sampleClipJob* job = (const sampleClipJob*) userData;
+    const int begin = chunkIndex * job->chunkSize;
+    const int end = (begin + job->chunkSize) < job->numTimes ? (begin + job->chunkSize) : job->numTimes;
+    for (int i = begin; i < end; i++) {
+        if (job->fixedPoint) {
+            animSequencer::sampleFixed(*job->clip, job->times[i], job->out + i * job->stride, job->stride);
+        }
+        else {
+            animSequencer::sample(*job->clip, job->times[i], job->out + i * job->stride, job->stride);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::sampleClip(const AnimLibrary* lib, int clipIndex, const double* times, int numTimes, float* out) {
+    o_assert_dbg(lib && times && out);
+    // sampling is stateless, so the time range can simply be split
+    // into chunks which are sampled by the persistent worker threads
+    // (started on first use) and the calling thread
+    sampleClipJob job;
+    job.clip = &(lib->Clips[clipIndex]);
+    job.times = times;
+    job.out = out;
+    job.stride = lib->SampleStride;
+    job.numTimes = numTimes;
+    job.chunkSize = numTimes;
+    job.fixedPoint = AnimEvalMode::FixedPoint == this->animSetup.EvalMode;
+    int numChunks = numTimes / minSampleClipTimesPerThread;
+    if (numChunks > 1) {
+        if (!this->sampleWorkers.isValid()) {
+            #if ORYOL_HAS_THREADS
+            int numWorkers = int(std::thread::hardware_concurrency()) - 1;
+            #else
+            int numWorkers = 0;
+            #endif
+            if (numWorkers > animWorkerPool::maxWorkers) {
+                numWorkers = animWorkerPool::maxWorkers;
+            }
+            this->sampleWorkers.setup(numWorkers > 0 ? numWorkers : 0);
+        }
+        if (numChunks > (this->sampleWorkers.numWorkers() + 1)) {
+            numChunks = this->sampleWorkers.numWorkers() + 1;
+        }
+    }
+    if (numChunks > 1) {
+        job.chunkSize = (numTimes + numChunks - 1) / numChunks;
+        this->sampleWorkers.run(sampleClipChunk, &job, numChunks);
+    }
+    else {
+        sampleClipChunk(&job, 0);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::newFrame() {
+    o_assert_dbg(!this->inFrame);
+    for (animInstance* inst : this->activeInstances) {
+        inst->samples.Reset();
+        inst->skinMatrices.Reset();
+        inst->velocities.Reset();
+    }
+    this->activeInstances.Clear();
+    this->skinInfoInstances.Clear();
+    this->numSamples = 0;
+    this->numFixedSamples = 0;
+    this->curSkinMatrixTableX = 0;
+    this->curSkinMatrixTableY = 0;
+    this->frameIndex++;
+    if (this->hotKeyPool && (0 == (this->frameIndex % hotClipUpdateFrames))) {
+        this->updateHotClips();
+    }
+    this->inFrame = true;
+    this->skinMatrixInfo.SkinMatrixTableByteSize = 0;
+    this->skinMatrixInfo.InstanceInfos.Clear();
+    this->skinMatrixInfo.DirtyRanges.Clear();
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::resetHotClips(AnimLibrary* lib) {
+    for (auto& clip : lib->Clips) {
+        if (clip.HotKeys) {
+            this->demoteHotClip(&clip);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::demoteHotClip(AnimClip* clip) {
+    o_assert_dbg(clip->HotKeys);
+    const int offset = int(clip->HotKeys - this->hotKeyPool);
+    this->hotKeyBlocks.free(offset, clip->Length * clip->KeyStride);
+    clip->HotKeys = nullptr;
+    const int index = this->hotClips.FindIndexLinear(clip);
+    o_assert_dbg(InvalidIndex != index);
+    this->hotClips.EraseSwap(index);
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::updateHotClips() {
+    o_assert_dbg(this->hotKeyPool);
+
+    // collect all clips which have been played since the last update
+    this->hotClipCandidates.Clear();
+    for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->libPool.LastAllocSlot; slotIndex++) {
+        AnimLibrary& lib = this->libPool.slots[slotIndex];
+        if (lib.Id.IsValid()) {
+            for (auto& clip : lib.Clips) {
+                if ((clip.PlayCount > 0) && !clip.Keys.Empty() && !clip.DeltaKeys) {
+                    this->hotClipCandidates.Add(&clip);
+                }
+            }
+        }
+    }
+
+    // select the most played clips which fit into the hot key pool,
+    // play counts decay so that clips which stop being played are demoted
+    std::sort(this->hotClipCandidates.begin(), this->hotClipCandidates.end(),
+        [](const AnimClip* a, const AnimClip* b) {
+            return a->PlayCount > b->PlayCount;
+        });
+    int numSelected = 0;
+    int size = 0;
+    for (AnimClip* clip : this->hotClipCandidates) {
+        const int clipSize = clip->Length * clip->KeyStride;
+        if ((size + clipSize) <= this->animSetup.HotKeyPoolCapacity) {
+            this->hotClipCandidates[numSelected++] = clip;
+            size += clipSize;
+        }
+        clip->PlayCount >>= 1;
+    }
+    const AnimClip* const* selBegin = this->hotClipCandidates.begin();
+    const AnimClip* const* selEnd = selBegin + numSelected;
+
+    // demote the hot clips which are no longer selected first, so that
+    // their keys can be reused, clips which stay hot keep their keys
+    for (int i = this->hotClips.Size() - 1; i >= 0; i--) {
+        AnimClip* clip = this->hotClips[i];
+        if (std::find(selBegin, selEnd, clip) == selEnd) {
+            this->demoteHotClip(clip);
+        }
+    }
+
+    // only the newly promoted clips need to decode their keys, a clip
+    // which doesn't fit into a fragmented pool stays cold until the next update
+    for (int i = 0; i < numSelected; i++) {
+        AnimClip* clip = this->hotClipCandidates[i];
+        if (clip->HotKeys) {
+            continue;
+        }
+        const int offset = this->hotKeyBlocks.alloc(clip->Length * clip->KeyStride);
+        if (InvalidIndex == offset) {
+            continue;
+        }
+        float* dst = this->hotKeyPool + offset;
+        for (int keyIndex = 0; keyIndex < clip->Length; keyIndex++) {
+            animKeyCache::decodeRow(*clip, keyIndex, dst + keyIndex * clip->KeyStride);
+        }
+        clip->HotKeys = dst;
+        this->hotClips.Add(clip);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+animMgr::addActiveInstance(animInstance* inst, float* samplesDst, float* skinMatricesDst, int lod) {
+    o_assert_dbg(inst && inst->library);
+    o_assert_dbg(this->inFrame);
+    o_assert_dbg((lod >= 0) && (lod <= AnimConfig::BakedClipLod));
+    
+    // check if resource limits are reached for this frame
+    if (this->activeInstances.Size() == this->activeInstances.Capacity()) {
+        // MaxNumActiveInstances reached
+        return false;
+    }
+    // a follower plays the anim jobs of its leader, and shares the 
+    // leader's outputs if there's no time offset and the leader
+    // has already been added in this frame
+    inst->sharedLeader = nullptr;
+    if (inst->leaderId.IsValid()) {
+        animInstance* leader = this->instPool.Lookup(inst->leaderId);
+        if (leader && (leader->library == inst->library)) {
+            this->syncLeader(inst, leader);
+            if ((0.0 == inst->leaderTimeOffset) && !samplesDst && !skinMatricesDst && !leader->samples.Empty() &&
+                (leader->library == inst->library) && (leader->skeleton == inst->skeleton) && 
+                (leader->hasVelocities == inst->hasVelocities))
+            {
+                this->addSharedInstance(inst, leader);
+                return true;
+            }
+        }
+    }
+    const int sampleStride = inst->library->SampleStride;
+    const int numPoolSamples = (samplesDst ? 0 : sampleStride) + (inst->hasVelocities ? sampleStride : 0);
+    if ((this->numSamples + numPoolSamples) > this->samples.Size()) {
+        // no more room in samples pool
+        return false;
+    }
+    if (this->fixedSamplePool && ((this->numFixedSamples + sampleStride) > this->fixedSamples.Size())) {
+        return false;
+    }
+    if (inst->skeleton && !skinMatricesDst) {
+        if (((this->curSkinMatrixTableX + (inst->skeleton->NumBones*3)) > this->animSetup.SkinMatrixTableWidth) &&
+            ((this->curSkinMatrixTableY + 1) > this->animSetup.SkinMatrixTableHeight))
+        {
+            // not enough room in the skin matrix table
+            return false;
+        }
+    }
+    this->activeInstances.Add(inst);
+    inst->lod = lod;
+
+    // assign the samples slice, either in the sample pool or caller-owned memory
+    if (samplesDst) {
+        inst->samples = Slice<float>(samplesDst, sampleStride, 0, sampleStride);
+    }
+    else {
+        inst->samples = this->samples.MakeSlice(this->numSamples, sampleStride);
+        this->numSamples += sampleStride;
+    }
+    // velocities are always in the sample pool
+    if (inst->hasVelocities) {
+        inst->velocities = this->samples.MakeSlice(this->numSamples, sampleStride);
+        this->numSamples += sampleStride;
+    }
+    if (this->fixedSamplePool) {
+        inst->fixedSamples = this->fixedSamples.MakeSlice(this->numFixedSamples, sampleStride);
+        this->numFixedSamples += sampleStride;
+    }
+
+    // assign the skin matrix slice, caller-owned skin matrices don't
+    // take room in the skin matrix table and have no InstanceInfo
+    inst->skinInfoIndex = InvalidIndex;
+    if (inst->skeleton && skinMatricesDst) {
+        const int numFloats = inst->skeleton->NumBones * 3 * 4;
+        inst->skinMatrices = Slice<float>(skinMatricesDst, numFloats, 0, numFloats);
+    }
+    else if (inst->skeleton) {
         // each skeleton bones in the skin matrix table takes up 4*3 floats for a
         // transposed 4x3 matrix:
         //
@@ -478,6 +1531,8 @@ animMgr::addActiveInstance(animInstance* inst) {
 
         // update skinMatrixInfo
         this->skinMatrixInfo.SkinMatrixTableByteSize = (this->curSkinMatrixTableY+1)*this->skinMatrixTableStride * 4;
+        inst->skinInfoIndex = this->skinMatrixInfo.InstanceInfos.Size();
+        this->skinInfoInstances.Add(inst);
         auto& info = this->skinMatrixInfo.InstanceInfos.Add();
         info.Instance = inst->Id;
         const float halfPixelX = 0.5f / float(this->animSetup.SkinMatrixTableWidth);
@@ -488,32 +1543,372 @@ animMgr::addActiveInstance(animInstance* inst) {
 
         // advance to next skin matrix table position
         this->curSkinMatrixTableX += inst->skeleton->NumBones * 3;
+        if (this->animSetup.StreamSkinMatrices) {
+            // with streaming stores, each instance starts at a cache line (4 'pixels')
+            const int pixelsPerLine = skinMatrixAlignment / (4 * sizeof(float));
+            this->curSkinMatrixTableX = (this->curSkinMatrixTableX + pixelsPerLine - 1) & ~(pixelsPerLine - 1);
+        }
     }
     return true;
 }
 
+//------------------------------------------------------------------------------
+void
+animMgr::syncLeader(animInstance* inst, const animInstance* leader) {
+    o_assert_dbg(leader->library == inst->library);
+    // copy the leader's anim jobs, shifted by the time offset
+    const double offset = inst->leaderTimeOffset;
+    animSequencer::item ownItems[animSequencer::maxItems];
+    const int numOwnItems = inst->sequencer.items.Size();
+    for (int i = 0; i < numOwnItems; i++) {
+        ownItems[i] = inst->sequencer.items[i];
+    }
+    inst->sequencer.items = leader->sequencer.items;
+    if (0.0 != offset) {
+        for (auto& item : inst->sequencer.items) {
+            item.absStartTime += offset;
+            item.absFadeInTime = (item.absFadeInTime < DBL_MAX) ? item.absFadeInTime + offset : DBL_MAX;
+            item.absFadeOutTime = (item.absFadeOutTime < DBL_MAX) ? item.absFadeOutTime + offset : DBL_MAX;
+            item.absEndTime = (item.absEndTime < DBL_MAX) ? item.absEndTime + offset : DBL_MAX;
+        }
+    }
+
+    // a follower which lags behind its leader still plays jobs which
+    // the leader has already garbage-collected, keep the follower's
+    // copies of those jobs until they have expired at follower time
+    auto& items = inst->sequencer.items;
+    for (int ownIndex = 0; ownIndex < numOwnItems; ownIndex++) {
+        const animSequencer::item& own = ownItems[ownIndex];
+        const bool expiredForLeader = (own.absEndTime - offset) < this->curTime;
+        if (!own.valid || !expiredForLeader || (own.absEndTime < this->curTime) || items.Full()) {
+            continue;
+        }
+        bool inLeader = false;
+        for (const auto& item : items) {
+            if (item.id == own.id) {
+                inLeader = true;
+                break;
+            }
+        }
+        if (!inLeader) {
+            // same order as animSequencer::add(), by track index and start time
+            int insertIndex = 0;
+            while ((insertIndex < items.Size()) &&
+                   ((items[insertIndex].trackIndex < own.trackIndex) ||
+                    ((items[insertIndex].trackIndex == own.trackIndex) && (items[insertIndex].absStartTime <= own.absStartTime))))
+            {
+                insertIndex++;
+            }
+            items.Insert(insertIndex, own);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::addSharedInstance(animInstance* inst, animInstance* leader) {
+    // a follower which shares the outputs of its leader, it doesn't
+    // take room in the sample pool or skin matrix table, and isn't evaluated
+    this->activeInstances.Add(inst);
+    inst->sharedLeader = leader;
+    inst->samples = leader->samples;
+    inst->fixedSamples = leader->fixedSamples;
+    inst->velocities = leader->velocities;
+    inst->skinMatrices = leader->skinMatrices;
+    inst->skinInfoIndex = InvalidIndex;
+    if (InvalidIndex != leader->skinInfoIndex) {
+        inst->skinInfoIndex = this->skinMatrixInfo.InstanceInfos.Size();
+        this->skinInfoInstances.Add(inst);
+        auto& info = this->skinMatrixInfo.InstanceInfos.Add();
+        info.Instance = inst->Id;
+        info.ShaderInfo = this->skinMatrixInfo.InstanceInfos[leader->skinInfoIndex].ShaderInfo;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+collectJobs(animInstance* inst, double curTime) {
+    // remove expired anim jobs, but keep jobs which ended since the last
+    // root motion extraction until their remaining root motion is extracted
+    double time = curTime;
+    if ((InvalidIndex != inst->library->RootMotionCurve) && (inst->rootMotionTime >= 0.0) && (inst->rootMotionTime < curTime)) {
+        time = inst->rootMotionTime;
+    }
+    inst->sequencer.garbageCollect(time);
+}
+
 //------------------------------------------------------------------------------
 void
 animMgr::evaluate(double frameDur) {
     o_assert_dbg(this->inFrame);
     // garbage-collect anim jobs in all active instances
     for (animInstance* inst : this->activeInstances) {
-        inst->sequencer.garbageCollect(this->curTime);
+        collectJobs(inst, this->curTime);
+    }
+    // optionally reorder the evaluation work so that instances using the
+    // same clips and skeletons are processed back to back, this doesn't
+    // affect the assigned sample and skin matrix slices, or the order
+    // of InstanceInfos
+    if (this->animSetup.SortActiveInstances) {
+        this->sortActiveInstances();
+    }
+    // find instances which need to be evaluated, followers which share
+    // their leader's outputs are never evaluated, but are dirty with the leader
+    this->checkDirtyInstances();
+    for (animInstance* inst : this->activeInstances) {
+        if (inst->sharedLeader) {
+            inst->dirty = inst->sharedLeader->dirty;
+        }
+    }
+    // update the play counters of evaluated clips for hot clip selection
+    if (this->hotKeyPool) {
+        int clipIndices[animSequencer::maxItems];
+        for (animInstance* inst : this->activeInstances) {
+            if (inst->sharedLeader) {
+                continue;
+            }
+            const int numClips = inst->sequencer.activeClips(this->curTime, clipIndices);
+            for (int i = 0; i < numClips; i++) {
+                inst->library->Clips[clipIndices[i]].PlayCount++;
+            }
+        }
     }
-    // evaluate animation of all active instances
+    const bool fixedPoint = AnimEvalMode::FixedPoint == this->animSetup.EvalMode;
+    // evaluate animation of all active instances, instances which only
+    // play a single clip are collected and sampled in groups if enough
+    // of them play the same clip
+    const bool groupSampling = !fixedPoint && (this->animSetup.MinSampleGroupSize > 0);
+    animKeyCache* keyCache = this->keyCache.isValid() ? &this->keyCache : nullptr;
+    this->sampleGroupItems.Clear();
     for (animInstance* inst : this->activeInstances) {
-        inst->sequencer.eval(inst->library, this->curTime, inst->samples.begin(), inst->samples.Size());
+        inst->baked = false;
+        if (!inst->dirty || inst->sharedLeader) {
+            continue;
+        }
+        if (!fixedPoint && (AnimConfig::BakedClipLod == inst->lod) && this->genSkinMatricesBaked(inst)) {
+            // baked instances only output skin matrices
+            inst->baked = true;
+            if (inst->hasVelocities) {
+                Memory::Clear(inst->velocities.begin(), inst->velocities.Size() * sizeof(float));
+            }
+            continue;
+        }
+        if (fixedPoint) {
+            inst->sequencer.evalFixed(inst->library, this->curTime, inst->samples.begin(), inst->samples.Size(), inst->fixedSamples.begin());
+            if (inst->hasVelocities) {
+                Memory::Clear(inst->velocities.begin(), inst->velocities.Size() * sizeof(float));
+            }
+            continue;
+        }
+        if (inst->hasVelocities) {
+            inst->sequencer.eval(inst->library, this->curTime, inst->samples.begin(), inst->samples.Size(), inst->velocities.begin(), keyCache, inst->lod);
+            continue;
+        }
+        if (groupSampling && (0 == inst->lod)) {
+            const animSequencer::item* item = inst->sequencer.singleActiveItem(this->curTime);
+            if (item && !item->mirror) {
+                auto& groupItem = this->sampleGroupItems.Add();
+                groupItem.library = inst->library;
+                groupItem.clipIndex = item->clipIndex;
+                groupItem.clipTime = this->curTime - item->absStartTime;
+                groupItem.inst = inst;
+                continue;
+            }
+        }
+        inst->sequencer.eval(inst->library, this->curTime, inst->samples.begin(), inst->samples.Size(), nullptr, keyCache, inst->lod);
     }
-    // compute the skinning matrices for all active instances (which have skeletons)
+    if (!this->sampleGroupItems.Empty()) {
+        this->evalSampleGroups();
+    }
+    // extract root motion since the previous evaluation, this must 
+    // happen before skinning since the root motion is stripped from the samples
     for (animInstance* inst : this->activeInstances) {
-        if (inst->skeleton) {
-            this->genSkinMatrices(inst);
+        if (InvalidIndex != inst->library->RootMotionCurve) {
+            const double prevTime = inst->rootMotionTime < 0.0 ? this->curTime : inst->rootMotionTime;
+            const bool stripSamples = inst->dirty && !inst->baked && !inst->sharedLeader;
+            float* smp = stripSamples ? inst->samples.begin() : nullptr;
+            if (fixedPoint) {
+                int32_t* fixedSmp = stripSamples ? inst->fixedSamples.begin() : nullptr;
+                inst->sequencer.evalRootMotionFixed(inst->library, prevTime, this->curTime, smp, fixedSmp, inst->rootMotion);
+            }
+            else {
+                float* vel = (stripSamples && inst->hasVelocities) ? inst->velocities.begin() : nullptr;
+                inst->sequencer.evalRootMotion(inst->library, prevTime, this->curTime, smp, vel, inst->rootMotion);
+            }
+            inst->rootMotionTime = this->curTime;
         }
     }
+    // compute the skinning matrices for all active instances (which have skeletons),
+    // instances sharing a skeleton are skinned as group if there are enough of them
+    const bool groupSkinning = !fixedPoint && (this->animSetup.MinSkinGroupSize > 0);
+    this->skinGroupInstances.Clear();
+    for (animInstance* inst : this->activeInstances) {
+        if (inst->skeleton && inst->dirty && !inst->baked && !inst->sharedLeader) {
+            if (fixedPoint) {
+                this->genSkinMatricesFixed(inst);
+            }
+            else if (groupSkinning) {
+                this->skinGroupInstances.Add(inst);
+            }
+            else {
+                this->genSkinMatrices(inst);
+            }
+        }
+    }
+    if (!this->skinGroupInstances.Empty()) {
+        this->evalSkinGroups();
+    }
+    if (this->animSetup.StreamSkinMatrices) {
+        mx_stream_fence();
+    }
+    this->updateDirtyRanges();
     this->curTime += frameDur;
     this->inFrame = false;
 }
 
+//------------------------------------------------------------------------------
+static uint64_t
+sig_mix(uint64_t hash, uint64_t val) {
+    // mix a 64-bit value into a signature hash (FNV-1a on the whole value)
+    return (hash ^ val) * 0x100000001b3ULL;
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::checkDirtyInstances() {
+    // An instance doesn't need to be evaluated if it was evaluated in
+    // the previous frame with exactly the same inputs into the same
+    // output locations, since its samples and skin matrices from
+    // the previous frame are still in place.
+    const bool skip = this->animSetup.SkipUnchangedInstances;
+    for (animInstance* inst : this->activeInstances) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        hash = sig_mix(hash, uint64_t(uintptr_t(inst->library)));
+        hash = sig_mix(hash, uint64_t(uintptr_t(inst->skeleton)));
+        hash = sig_mix(hash, uint64_t(uintptr_t(inst->samples.begin())));
+        hash = sig_mix(hash, uint64_t(uintptr_t(inst->fixedSamples.begin())));
+        hash = sig_mix(hash, uint64_t(uintptr_t(inst->skinMatrices.begin())));
+        hash = sig_mix(hash, uint64_t(uintptr_t(inst->velocities.begin())));
+        hash = sig_mix(hash, this->keysVersion);
+        hash = inst->sequencer.evalSignature(inst->library, this->curTime, inst->lod, hash);
+        const bool unchanged = (hash == inst->evalSignature) && ((inst->evalFrameIndex + 1) == this->frameIndex);
+        inst->dirty = !(skip && unchanged);
+        inst->evalSignature = hash;
+        inst->evalFrameIndex = this->frameIndex;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::updateDirtyRanges() {
+    // update the per-instance dirty flags, and merge the dirty skin
+    // matrices of adjacent instances into byte ranges of the skin
+    // matrix table (instances are placed in the order of InstanceInfos),
+    // with streaming stores adjacent instances are separated by the
+    // padding to the next cache line, which is merged into the range
+    auto& info = this->skinMatrixInfo;
+    info.DirtyRanges.Clear();
+    const int maxGap = this->animSetup.StreamSkinMatrices ? (skinMatrixAlignment - 1) : 0;
+    const int numInfos = info.InstanceInfos.Size();
+    for (int i = 0; i < numInfos; i++) {
+        const animInstance* inst = this->skinInfoInstances[i];
+        info.InstanceInfos[i].Dirty = inst->dirty;
+        if (inst->dirty && !inst->sharedLeader) {
+            const int offset = inst->skinMatrices.Offset() * sizeof(float);
+            const int size = inst->skinMatrices.Size() * sizeof(float);
+            const int gap = info.DirtyRanges.Empty() ? -1 : (offset - (info.DirtyRanges.Back().Offset + info.DirtyRanges.Back().Size));
+            if ((gap >= 0) && (gap <= maxGap)) {
+                info.DirtyRanges.Back().Size += gap + size;
+            }
+            else {
+                auto& range = info.DirtyRanges.Add();
+                range.Offset = offset;
+                range.Size = size;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::sortActiveInstances() {
+    this->sortItems.Clear();
+    const int numInsts = this->activeInstances.Size();
+    for (int i = 0; i < numInsts; i++) {
+        animInstance* inst = this->activeInstances[i];
+        auto& item = this->sortItems.Add();
+        item.library = inst->library;
+        item.clipIndex = inst->sequencer.firstActiveClip(this->curTime);
+        item.skeleton = inst->skeleton;
+        item.index = i;
+        item.inst = inst;
+    }
+    // the original index makes the order deterministic
+    std::sort(this->sortItems.begin(), this->sortItems.end(),
+        [](const sortItem& a, const sortItem& b) {
+            if (a.library != b.library) {
+                return a.library < b.library;
+            }
+            if (a.clipIndex != b.clipIndex) {
+                return a.clipIndex < b.clipIndex;
+            }
+            if (a.skeleton != b.skeleton) {
+                return a.skeleton < b.skeleton;
+            }
+            return a.index < b.index;
+        });
+    for (int i = 0; i < numInsts; i++) {
+        this->activeInstances[i] = this->sortItems[i].inst;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::evalSampleGroups() {
+    // sort the collected single-clip instances by library and clip,
+    // and sample each run of instances which play the same clip 
+    // either as group, or one by one if the run is too short
+    std::sort(this->sampleGroupItems.begin(), this->sampleGroupItems.end(),
+        [](const sampleGroupItem& a, const sampleGroupItem& b) {
+            if (a.library != b.library) {
+                return a.library < b.library;
+            }
+            return a.clipIndex < b.clipIndex;
+        });
+    animKeyCache* keyCache = this->keyCache.isValid() ? &this->keyCache : nullptr;
+    double clipTimes[animSequencer::maxSampleGroupLanes];
+    float* sampleBuffers[animSequencer::maxSampleGroupLanes];
+    const int numItems = this->sampleGroupItems.Size();
+    int runStart = 0;
+    while (runStart < numItems) {
+        const sampleGroupItem& first = this->sampleGroupItems[runStart];
+        int runEnd = runStart + 1;
+        while ((runEnd < numItems) &&
+               (this->sampleGroupItems[runEnd].library == first.library) &&
+               (this->sampleGroupItems[runEnd].clipIndex == first.clipIndex)) {
+            runEnd++;
+        }
+        const AnimClip& clip = first.library->Clips[first.clipIndex];
+        if ((runEnd - runStart) >= this->animSetup.MinSampleGroupSize) {
+            for (int base = runStart; base < runEnd; base += animSequencer::maxSampleGroupLanes) {
+                int num = 0;
+                for (int i = base; (i < runEnd) && (num < animSequencer::maxSampleGroupLanes); i++, num++) {
+                    clipTimes[num] = this->sampleGroupItems[i].clipTime;
+                    sampleBuffers[num] = this->sampleGroupItems[i].inst->samples.begin();
+                }
+                animSequencer::sampleGroup(clip, clipTimes, sampleBuffers, num, keyCache);
+            }
+        }
+        else {
+            for (int i = runStart; i < runEnd; i++) {
+                const sampleGroupItem& item = this->sampleGroupItems[i];
+                animSequencer::sampleCached(clip, item.clipTime, item.inst->samples.begin(), keyCache);
+            }
+        }
+        runStart = runEnd;
+    }
+}
+
 //------------------------------------------------------------------------------
 static void
 mx_mul4x3(const float* m1, const float* m2, float* m) {
@@ -556,6 +1951,96 @@ mx_copy(const float* src, float* dst) {
     }
 }
 
+//------------------------------------------------------------------------------
+static void
+mx_trs(const float* smp, float* m) {
+    // samples bone translate, rotate (quat), scale to matrix
+    float tx=smp[0]; float ty=smp[1]; float tz=smp[2];
+    float qx=smp[3]; float qy=smp[4]; float qz=smp[5]; float qw=smp[6];
+    float sx=smp[7]; float sy=smp[8]; float sz=smp[9];
+    float qxx=qx*qx; float qyy=qy*qy; float qzz=qz*qz;
+    float qxz=qx*qz; float qxy=qx*qy; float qyz=qy*qz;
+    float qwx=qw*qx; float qwy=qw*qy; float qwz=qw*qz;
+    m[0]=sx*(1.0f-2.0f*(qyy+qzz)); m[1]=sx*(2.0f*(qxy+qwz));      m[2]=sx*(2.0f*(qxz-qwy));
+    m[3]=sy*(2.0f*(qxy-qwz));      m[4]=sy*(1.0f-2.0f*(qxx+qzz)); m[5]=sy*(2.0f*(qyz+qwx));
+    m[6]=sz*(2.0f*(qxz+qwy));      m[7]=sz*(2.0f*(qyz-qwx));      m[8]=sz*(1.0f-2.0f*(qxx+qyy));
+    m[9]=tx;                       m[10]=ty;                      m[11]=tz;
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::initStaticBones(AnimLibrary* lib) {
+    o_assert_dbg(lib);
+    lib->NumBones = 0;
+    lib->StaticBones.Clear();
+    lib->StaticBoneMatrices.Clear();
+
+    // only libraries with a (translate, rotate, scale) curve triple
+    // per bone can be used for skinning
+    const int numCurves = lib->CurveLayout.Size();
+    if ((0 != (numCurves % 3)) || (numCurves > AnimConfig::MaxNumCurvesInClip)) {
+        return;
+    }
+    for (int i = 0; i < numCurves; i += 3) {
+        if ((AnimCurveFormat::Float3 != lib->CurveLayout[i]) ||
+            (4 != AnimCurveFormat::Stride(lib->CurveLayout[i+1])) ||
+            (AnimCurveFormat::Float3 != lib->CurveLayout[i+2])) {
+            return;
+        }
+    }
+    lib->NumBones = numCurves / 3;
+
+    // for bones where all curves are static, the local bone matrix
+    // is computed once here instead of each frame in genSkinMatrices()
+    for (AnimClip& clip : lib->Clips) {
+        clip.StaticBoneIndex = InvalidIndex;
+        bool hasStaticBones = false;
+        for (const AnimCurve& curve : clip.Curves) {
+            hasStaticBones |= curve.Static;
+        }
+        if (!hasStaticBones) {
+            continue;
+        }
+        clip.StaticBoneIndex = lib->StaticBones.Size();
+        for (int boneIndex = 0; boneIndex < lib->NumBones; boneIndex++) {
+            const AnimCurve& t = clip.Curves[boneIndex*3 + 0];
+            const AnimCurve& r = clip.Curves[boneIndex*3 + 1];
+            const AnimCurve& s = clip.Curves[boneIndex*3 + 2];
+            const bool isStatic = t.Static && r.Static && s.Static;
+            lib->StaticBones.Add(isStatic ? 1 : 0);
+            glm::mat4x3& m = lib->StaticBoneMatrices.Add();
+            if (isStatic) {
+                const float smp[10] = {
+                    t.StaticValue[0], t.StaticValue[1], t.StaticValue[2],
+                    r.StaticValue[0], r.StaticValue[1], r.StaticValue[2], r.StaticValue[3],
+                    s.StaticValue[0], s.StaticValue[1], s.StaticValue[2]
+                };
+                mx_trs(smp, &m[0][0]);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+lookupStaticBones(const animInstance* inst, double curTime, const uint8_t*& outStaticBones, const float*& outStaticBoneMatrices) {
+    // get the static bone flags and precomputed local matrices if the
+    // instance plays a single (non-mirrored) clip which has static bones
+    outStaticBones = nullptr;
+    outStaticBoneMatrices = nullptr;
+    const AnimLibrary* lib = inst->library;
+    if (lib->NumBones >= inst->skeleton->NumBones) {
+        const animSequencer::item* item = inst->sequencer.singleActiveItem(curTime);
+        if (item && !item->mirror) {
+            const AnimClip& clip = lib->Clips[item->clipIndex];
+            if (InvalidIndex != clip.StaticBoneIndex) {
+                outStaticBones = &(lib->StaticBones[clip.StaticBoneIndex]);
+                outStaticBoneMatrices = &(lib->StaticBoneMatrices[clip.StaticBoneIndex][0][0]);
+            }
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 void
 animMgr::genSkinMatrices(animInstance* inst) {
@@ -568,44 +2053,413 @@ animMgr::genSkinMatrices(animInstance* inst) {
     // input samples (result of animation evaluation)
     const float* smp = &(inst->samples[0]);
 
-    float m0[12], m1[12];
+    // if a single clip is playing, the precomputed local matrices
+    // of static bones can be used directly
+    const uint8_t* staticBones = nullptr;
+    const float* staticBoneMatrices = nullptr;
+    lookupStaticBones(inst, this->curTime, staticBones, staticBoneMatrices);
+
+    // optionally write the output with non-temporal stores
+    const bool stream = this->animSetup.StreamSkinMatrices && mx_can_stream(outSkinMatrices);
+
+    float m0[12], m1[12], m2[12];
     float tmpBoneMatrices[AnimConfig::MaxNumSkeletonBones][12];
     const int numBones = inst->skeleton->NumBones;
     for (int boneIndex=0; boneIndex<numBones; boneIndex++, smp+=10, outSkinMatrices+=12) {
 
-        // samples bone translate, rotate (quat), scale to matrix
-        float tx=smp[0]; float ty=smp[1]; float tz=smp[2];
-        float qx=smp[3]; float qy=smp[4]; float qz=smp[5]; float qw=smp[6];
-        float sx=smp[7]; float sy=smp[8]; float sz=smp[9];
-        float qxx=qx*qx; float qyy=qy*qy; float qzz=qz*qz;
-        float qxz=qx*qz; float qxy=qx*qy; float qyz=qy*qz;
-        float qwx=qw*qx; float qwy=qw*qy; float qwz=qw*qz;
-        m0[0]=sx*(1.0f-2.0f*(qyy+qzz)); m0[1]=sx*(2.0f*(qxy+qwz));      m0[2]=sx*(2.0f*(qxz-qwy));
-        m0[3]=sy*(2.0f*(qxy-qwz));      m0[4]=sy*(1.0f-2.0f*(qxx+qzz)); m0[5]=sy*(2.0f*(qyz+qwx));
-        m0[6]=sz*(2.0f*(qxz+qwy));      m0[7]=sz*(2.0f*(qyz-qwx));      m0[8]=sz*(1.0f-2.0f*(qxx+qyy));
-        m0[9]=tx;                       m0[10]=ty;                      m0[11]=tz;
+        // local bone matrix from samples, or precomputed
+        const float* ml;
+        if (staticBones && staticBones[boneIndex]) {
+            ml = &staticBoneMatrices[boneIndex * 12];
+        }
+        else {
+            mx_trs(smp, m0);
+            ml = m0;
+        }
 
         // multiply with parent bone matrix
         const int32_t parentIndex = parentIndices[boneIndex];
         const float* m;
         if (-1 != parentIndex) {
-            mx_mul4x3(&tmpBoneMatrices[parentIndex][0], m0, m1);
+            mx_mul4x3(&tmpBoneMatrices[parentIndex][0], ml, m1);
             m = m1;
         }
         else {
-            m = m0;
+            m = ml;
         }
         mx_copy(m, &tmpBoneMatrices[boneIndex][0]);
 
         // multiply with inverse bind pose matrix into transposed skin matrix
-        mx_mul4x3_transpose(m, &invBindPose[boneIndex * 12], outSkinMatrices);
+        if (stream) {
+            mx_mul4x3_transpose(m, &invBindPose[boneIndex * 12], m2);
+            mx_stream(m2, outSkinMatrices);
+        }
+        else {
+            mx_mul4x3_transpose(m, &invBindPose[boneIndex * 12], outSkinMatrices);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+animMgr::genSkinMatricesBaked(animInstance* inst) {
+    o_assert_dbg(inst);
+    if (!inst->skeleton) {
+        return false;
+    }
+    const animSequencer::item* item = inst->sequencer.singleActiveItem(this->curTime);
+    if (!item || item->mirror) {
+        return false;
+    }
+    const AnimClip& clip = inst->library->Clips[item->clipIndex];
+    if (InvalidIndex == clip.BakedIndex) {
+        return false;
+    }
+    const AnimBakedClip& baked = inst->library->BakedClips[clip.BakedIndex];
+    if ((baked.Skeleton != inst->skeleton->Id) || (baked.NumBones != inst->skeleton->NumBones)) {
+        return false;
+    }
+
+    // decode and lerp the 2 baked key rows, this skips sampling and
+    // the bone hierarchy, lerping matrices is fine at crowd distances
+    int key0, key1;
+    double keyPos;
+    animSequencer::keyParams(clip, this->curTime - item->absStartTime, key0, key1, keyPos);
+    const float pos = float(keyPos);
+    const int numElements = baked.NumBones * 12;
+    const int16_t* src0 = &(baked.Keys[key0 * numElements]);
+    const int16_t* src1 = &(baked.Keys[key1 * numElements]);
+    const float* offset = baked.Offset.begin();
+    const float* scale = baked.Scale.begin();
+    float* dst = inst->skinMatrices.begin();
+    const bool stream = this->animSetup.StreamSkinMatrices && mx_can_stream(dst);
+    float m[12];
+    for (int i = 0; i < numElements; i += 12) {
+        for (int j = 0; j < 12; j++) {
+            const float v0 = offset[i+j] + float(src0[i+j]) * scale[i+j];
+            const float v1 = offset[i+j] + float(src1[i+j]) * scale[i+j];
+            m[j] = v0 + (v1 - v0) * pos;
+        }
+        if (stream) {
+            mx_stream(m, dst + i);
+        }
+        else {
+            mx_copy(m, dst + i);
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::evalSkinGroups() {
+    // sort the collected instances by skeleton, and skin each run
+    // of instances sharing a skeleton in lockstep if it is long enough
+    std::sort(this->skinGroupInstances.begin(), this->skinGroupInstances.end(),
+        [](const animInstance* a, const animInstance* b) {
+            return a->skeleton < b->skeleton;
+        });
+    const int numInsts = this->skinGroupInstances.Size();
+    int runStart = 0;
+    while (runStart < numInsts) {
+        const AnimSkeleton* skel = this->skinGroupInstances[runStart]->skeleton;
+        int runEnd = runStart + 1;
+        while ((runEnd < numInsts) && (this->skinGroupInstances[runEnd]->skeleton == skel)) {
+            runEnd++;
+        }
+        if ((runEnd - runStart) >= this->animSetup.MinSkinGroupSize) {
+            for (int base = runStart; base < runEnd; base += maxSkinGroupLanes) {
+                const int num = (runEnd - base) < maxSkinGroupLanes ? (runEnd - base) : maxSkinGroupLanes;
+                this->genSkinMatricesGroup(skel, &this->skinGroupInstances[base], num);
+            }
+        }
+        else {
+            for (int i = runStart; i < runEnd; i++) {
+                this->genSkinMatrices(this->skinGroupInstances[i]);
+            }
+        }
+        runStart = runEnd;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::genSkinMatricesGroup(const AnimSkeleton* skel, animInstance* const* insts, int num) {
+    o_assert_dbg(skel && insts && (num > 0) && (num <= maxSkinGroupLanes));
+    o_assert_dbg(this->skinGroupScratch);
+
+    // Same math as genSkinMatrices(), but each matrix element is an
+    // array of maxSkinGroupLanes values, one per instance. Since all
+    // instances share the skeleton, the hierarchy walk is identical
+    // for all lanes, and the inner loops over lanes vectorize without
+    // a dependency on the previous bone. Unused lanes are filled with
+    // the samples of lane 0 so the lane loops have a constant trip count,
+    // their results are not written.
+    const int L = maxSkinGroupLanes;
+    const int32_t* parentIndices = &skel->ParentIndices[0];
+    const float* invBindPose = &(skel->InvBindPose[0][0][0]);
+    const float* smp[L];
+    float* outSkinMatrices[L];
+    const uint8_t* staticBones[L];
+    const float* staticBoneMatrices[L];
+    for (int lane = 0; lane < L; lane++) {
+        animInstance* inst = insts[lane < num ? lane : 0];
+        o_assert_dbg(inst->skeleton == skel);
+        smp[lane] = inst->samples.begin();
+        outSkinMatrices[lane] = inst->skinMatrices.begin();
+        lookupStaticBones(inst, this->curTime, staticBones[lane], staticBoneMatrices[lane]);
+    }
+    // if all lanes play the same clip, static bones are static in all lanes
+    bool sharedStaticBones = (nullptr != staticBones[0]);
+    bool anyStaticBones = false;
+    for (int lane = 0; lane < L; lane++) {
+        sharedStaticBones &= (staticBones[lane] == staticBones[0]);
+        anyStaticBones |= (nullptr != staticBones[lane]);
+    }
+    bool stream[L];
+    for (int lane = 0; lane < L; lane++) {
+        stream[lane] = this->animSetup.StreamSkinMatrices && mx_can_stream(outSkinMatrices[lane]);
+    }
+    float s[10][L];
+    float ml[12][L];
+    float out[12][L];
+    float tmp[12];
+    float* world = this->skinGroupScratch;
+    const int numBones = skel->NumBones;
+    for (int boneIndex = 0; boneIndex < numBones; boneIndex++) {
+
+        if (sharedStaticBones && staticBones[0][boneIndex]) {
+            // the precomputed local matrix of a static bone is the same in all lanes
+            const float* src = &staticBoneMatrices[0][boneIndex * 12];
+            for (int i = 0; i < 12; i++) {
+                for (int lane = 0; lane < L; lane++) {
+                    ml[i][lane] = src[i];
+                }
+            }
+        }
+        else {
+            // transpose the bone's samples into lanes
+            for (int i = 0; i < 10; i++) {
+                for (int lane = 0; lane < L; lane++) {
+                    s[i][lane] = smp[lane][boneIndex*10 + i];
+                }
+            }
+            // local bone matrix from samples
+            for (int lane = 0; lane < L; lane++) {
+                const float tx=s[0][lane], ty=s[1][lane], tz=s[2][lane];
+                const float qx=s[3][lane], qy=s[4][lane], qz=s[5][lane], qw=s[6][lane];
+                const float sx=s[7][lane], sy=s[8][lane], sz=s[9][lane];
+                const float qxx=qx*qx, qyy=qy*qy, qzz=qz*qz;
+                const float qxz=qx*qz, qxy=qx*qy, qyz=qy*qz;
+                const float qwx=qw*qx, qwy=qw*qy, qwz=qw*qz;
+                ml[0][lane]=sx*(1.0f-2.0f*(qyy+qzz)); ml[1][lane]=sx*(2.0f*(qxy+qwz));       ml[2][lane]=sx*(2.0f*(qxz-qwy));
+                ml[3][lane]=sy*(2.0f*(qxy-qwz));      ml[4][lane]=sy*(1.0f-2.0f*(qxx+qzz));  ml[5][lane]=sy*(2.0f*(qyz+qwx));
+                ml[6][lane]=sz*(2.0f*(qxz+qwy));      ml[7][lane]=sz*(2.0f*(qyz-qwx));       ml[8][lane]=sz*(1.0f-2.0f*(qxx+qyy));
+                ml[9][lane]=tx;                       ml[10][lane]=ty;                       ml[11][lane]=tz;
+            }
+            if (anyStaticBones) {
+                // static bones which aren't shared by all lanes are patched per lane
+                for (int lane = 0; lane < L; lane++) {
+                    if (staticBones[lane] && staticBones[lane][boneIndex]) {
+                        const float* src = &staticBoneMatrices[lane][boneIndex * 12];
+                        for (int i = 0; i < 12; i++) {
+                            ml[i][lane] = src[i];
+                        }
+                    }
+                }
+            }
+        }
+
+        // multiply with parent bone matrix (same as mx_mul4x3)
+        float (*m)[L] = (float(*)[L]) &world[boneIndex * 12 * L];
+        const int32_t parentIndex = parentIndices[boneIndex];
+        if (-1 != parentIndex) {
+            const float (*p)[L] = (const float(*)[L]) &world[parentIndex * 12 * L];
+            for (int lane = 0; lane < L; lane++) {
+                m[0][lane]  = p[0][lane]*ml[0][lane] + p[3][lane]*ml[1][lane] + p[6][lane]*ml[2][lane];
+                m[1][lane]  = p[1][lane]*ml[0][lane] + p[4][lane]*ml[1][lane] + p[7][lane]*ml[2][lane];
+                m[2][lane]  = p[2][lane]*ml[0][lane] + p[5][lane]*ml[1][lane] + p[8][lane]*ml[2][lane];
+                m[3][lane]  = p[0][lane]*ml[3][lane] + p[3][lane]*ml[4][lane] + p[6][lane]*ml[5][lane];
+                m[4][lane]  = p[1][lane]*ml[3][lane] + p[4][lane]*ml[4][lane] + p[7][lane]*ml[5][lane];
+                m[5][lane]  = p[2][lane]*ml[3][lane] + p[5][lane]*ml[4][lane] + p[8][lane]*ml[5][lane];
+                m[6][lane]  = p[0][lane]*ml[6][lane] + p[3][lane]*ml[7][lane] + p[6][lane]*ml[8][lane];
+                m[7][lane]  = p[1][lane]*ml[6][lane] + p[4][lane]*ml[7][lane] + p[7][lane]*ml[8][lane];
+                m[8][lane]  = p[2][lane]*ml[6][lane] + p[5][lane]*ml[7][lane] + p[8][lane]*ml[8][lane];
+                m[9][lane]  = p[0][lane]*ml[9][lane] + p[3][lane]*ml[10][lane] + p[6][lane]*ml[11][lane] + p[9][lane];
+                m[10][lane] = p[1][lane]*ml[9][lane] + p[4][lane]*ml[10][lane] + p[7][lane]*ml[11][lane] + p[10][lane];
+                m[11][lane] = p[2][lane]*ml[9][lane] + p[5][lane]*ml[10][lane] + p[8][lane]*ml[11][lane] + p[11][lane];
+            }
+        }
+        else {
+            for (int i = 0; i < 12; i++) {
+                for (int lane = 0; lane < L; lane++) {
+                    m[i][lane] = ml[i][lane];
+                }
+            }
+        }
+
+        // multiply with inverse bind pose matrix (same as mx_mul4x3_transpose),
+        // the inverse bind pose is shared by all lanes
+        const float* ibp = &invBindPose[boneIndex * 12];
+        for (int lane = 0; lane < L; lane++) {
+            out[0][lane]  = m[0][lane]*ibp[0] + m[3][lane]*ibp[1]  + m[6][lane]*ibp[2];
+            out[1][lane]  = m[0][lane]*ibp[3] + m[3][lane]*ibp[4]  + m[6][lane]*ibp[5];
+            out[2][lane]  = m[0][lane]*ibp[6] + m[3][lane]*ibp[7]  + m[6][lane]*ibp[8];
+            out[3][lane]  = m[0][lane]*ibp[9] + m[3][lane]*ibp[10] + m[6][lane]*ibp[11] + m[9][lane];
+            out[4][lane]  = m[1][lane]*ibp[0] + m[4][lane]*ibp[1]  + m[7][lane]*ibp[2];
+            out[5][lane]  = m[1][lane]*ibp[3] + m[4][lane]*ibp[4]  + m[7][lane]*ibp[5];
+            out[6][lane]  = m[1][lane]*ibp[6] + m[4][lane]*ibp[7]  + m[7][lane]*ibp[8];
+            out[7][lane]  = m[1][lane]*ibp[9] + m[4][lane]*ibp[10] + m[7][lane]*ibp[11] + m[10][lane];
+            out[8][lane]  = m[2][lane]*ibp[0] + m[5][lane]*ibp[1]  + m[8][lane]*ibp[2];
+            out[9][lane]  = m[2][lane]*ibp[3] + m[5][lane]*ibp[4]  + m[8][lane]*ibp[5];
+            out[10][lane] = m[2][lane]*ibp[6] + m[5][lane]*ibp[7]  + m[8][lane]*ibp[8];
+            out[11][lane] = m[2][lane]*ibp[9] + m[5][lane]*ibp[10] + m[8][lane]*ibp[11] + m[11][lane];
+        }
+
+        // transpose lanes back into the instances' skin matrices
+        for (int lane = 0; lane < num; lane++) {
+            float* dst = outSkinMatrices[lane] + boneIndex * 12;
+            if (stream[lane]) {
+                for (int i = 0; i < 12; i++) {
+                    tmp[i] = out[i][lane];
+                }
+                mx_stream(tmp, dst);
+            }
+            else {
+                for (int i = 0; i < 12; i++) {
+                    dst[i] = out[i][lane];
+                }
+            }
+        }
+    }
+}
+
+#if ORYOL_ANIM_FIXED_SSE2
+//------------------------------------------------------------------------------
+static __m128i
+mx_mul_epi32(__m128i a, __m128i b) {
+    // signed 32x32 => 64 bit multiply of elements 0 and 2, SSE2 only has
+    // the unsigned multiply, the sign correction is exact modulo 2^64
+    const __m128i p = _mm_mul_epu32(a, b);
+    const __m128i c = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b), _mm_and_si128(_mm_srai_epi32(b, 31), a));
+    return _mm_sub_epi64(p, _mm_slli_epi64(c, 32));
+}
+#endif
+
+//------------------------------------------------------------------------------
+static void
+mx_dot4_fixed(const int32_t (*a)[12], const int32_t (*b)[12], int32_t* out) {
+    // out[i] = roundShift(a[0][i]*b[0][i] + ... + a[3][i]*b[3][i]), the
+    // products are summed in 64 bits and rounded once; the SSE2 path
+    // computes exactly the same integer results, 4 elements at a time
+    #if ORYOL_ANIM_FIXED_SSE2
+    const __m128i round = _mm_set1_epi64x(int64_t(1) << (animFixed::FracBits - 1));
+    const __m128i lowMask = _mm_set1_epi64x(0xFFFFFFFF);
+    for (int i = 0; i < 12; i += 4) {
+        __m128i even = round;
+        __m128i odd = round;
+        for (int k = 0; k < 4; k++) {
+            const __m128i va = _mm_loadu_si128((const __m128i*) &a[k][i]);
+            const __m128i vb = _mm_loadu_si128((const __m128i*) &b[k][i]);
+            even = _mm_add_epi64(even, mx_mul_epi32(va, vb));
+            odd = _mm_add_epi64(odd, mx_mul_epi32(_mm_srli_epi64(va, 32), _mm_srli_epi64(vb, 32)));
+        }
+        // the low 32 bits of a logical and an arithmetic shift are identical
+        even = _mm_srli_epi64(even, animFixed::FracBits);
+        odd = _mm_srli_epi64(odd, animFixed::FracBits);
+        _mm_storeu_si128((__m128i*) &out[i], _mm_or_si128(_mm_and_si128(even, lowMask), _mm_slli_epi64(odd, 32)));
+    }
+    #else
+    for (int i = 0; i < 12; i++) {
+        int64_t v = 0;
+        for (int k = 0; k < 4; k++) {
+            v += int64_t(a[k][i]) * b[k][i];
+        }
+        out[i] = int32_t(animFixed::roundShift(v, animFixed::FracBits));
+    }
+    #endif
+}
+
+//------------------------------------------------------------------------------
+static void
+mx_mul4x3_fixed(const int32_t* m1, const int32_t* m2, int32_t* m) {
+    // same as mx_mul4x3 on Q16.16 values, the operands of each element's
+    // dot product are gathered so that all elements are computed alike
+    int32_t a[4][12], b[4][12];
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 3; row++) {
+            const int i = col*3 + row;
+            for (int k = 0; k < 3; k++) {
+                a[k][i] = m1[k*3 + row];
+                b[k][i] = m2[col*3 + k];
+            }
+            a[3][i] = m1[9 + row];
+            b[3][i] = (3 == col) ? animFixed::One : 0;
+        }
+    }
+    mx_dot4_fixed(a, b, m);
+}
+
+//------------------------------------------------------------------------------
+static void
+mx_mul4x3_transpose_fixed(const int32_t* m1, const int32_t* m2, float* m) {
+    // same as mx_mul4x3_transpose, with Q16.16 inputs and float output
+    int32_t tmp[12];
+    mx_mul4x3_fixed(m1, m2, tmp);
+    for (int row = 0; row < 3; row++) {
+        for (int col = 0; col < 4; col++) {
+            m[row*4 + col] = animFixed::toFloat(tmp[col*3 + row]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::genSkinMatricesFixed(animInstance* inst) {
+    o_assert_dbg(inst && inst->skeleton && !inst->fixedSamples.Empty());
+    const int32_t* parentIndices = &inst->skeleton->ParentIndices[0];
+    const int32_t* invBindPose = &(inst->skeleton->FixedInvBindPose[0]);
+    float* outSkinMatrices = &(inst->skinMatrices[0]);
+    // the samples are taken directly from the Q16.16 evaluation result
+    const int32_t* smp = inst->fixedSamples.begin();
+
+    const int32_t one = animFixed::One;
+    int32_t m0[12], m1[12];
+    int32_t tmpBoneMatrices[AnimConfig::MaxNumSkeletonBones][12];
+    const int numBones = inst->skeleton->NumBones;
+    for (int boneIndex=0; boneIndex<numBones; boneIndex++, smp+=10, outSkinMatrices+=12) {
+        const int32_t* s = smp;
+        const int32_t tx=s[0], ty=s[1], tz=s[2];
+        const int32_t qx=s[3], qy=s[4], qz=s[5], qw=s[6];
+        const int32_t sx=s[7], sy=s[8], sz=s[9];
+        const int32_t qxx=animFixed::mul(qx,qx), qyy=animFixed::mul(qy,qy), qzz=animFixed::mul(qz,qz);
+        const int32_t qxz=animFixed::mul(qx,qz), qxy=animFixed::mul(qx,qy), qyz=animFixed::mul(qy,qz);
+        const int32_t qwx=animFixed::mul(qw,qx), qwy=animFixed::mul(qw,qy), qwz=animFixed::mul(qw,qz);
+        m0[0]=animFixed::mul(sx,one-2*(qyy+qzz)); m0[1]=animFixed::mul(sx,2*(qxy+qwz));     m0[2]=animFixed::mul(sx,2*(qxz-qwy));
+        m0[3]=animFixed::mul(sy,2*(qxy-qwz));     m0[4]=animFixed::mul(sy,one-2*(qxx+qzz)); m0[5]=animFixed::mul(sy,2*(qyz+qwx));
+        m0[6]=animFixed::mul(sz,2*(qxz+qwy));     m0[7]=animFixed::mul(sz,2*(qyz-qwx));     m0[8]=animFixed::mul(sz,one-2*(qxx+qyy));
+        m0[9]=tx;                                 m0[10]=ty;                                m0[11]=tz;
+
+        const int32_t parentIndex = parentIndices[boneIndex];
+        const int32_t* m;
+        if (-1 != parentIndex) {
+            mx_mul4x3_fixed(&tmpBoneMatrices[parentIndex][0], m0, m1);
+            m = m1;
+        }
+        else {
+            m = m0;
+        }
+        for (int i = 0; i < 12; i++) {
+            tmpBoneMatrices[boneIndex][i] = m[i];
+        }
+        mx_mul4x3_transpose_fixed(m, invBindPose + boneIndex*12, outSkinMatrices);
     }
 }
 
 //------------------------------------------------------------------------------
 AnimJobId
 animMgr::play(animInstance* inst, const AnimJob& job) {
-    inst->sequencer.garbageCollect(this->curTime);
+    collectJobs(inst, this->curTime);
     AnimJobId jobId = ++this->curAnimJobId;
     const auto& clip = inst->library->Clips[job.ClipIndex];
     double clipDuration = clip.KeyDuration * clip.Length;
@@ -621,21 +2475,72 @@ animMgr::play(animInstance* inst, const AnimJob& job) {
 void
 animMgr::stop(animInstance* inst, AnimJobId jobId, bool allowFadeOut) {
     inst->sequencer.stop(this->curTime, jobId, allowFadeOut);
-    inst->sequencer.garbageCollect(this->curTime);
+    collectJobs(inst, this->curTime);
 }
 
 //------------------------------------------------------------------------------
 void
 animMgr::stopTrack(animInstance* inst, int trackIndex, bool allowFadeOut) {
     inst->sequencer.stopTrack(this->curTime, trackIndex, allowFadeOut);
-    inst->sequencer.garbageCollect(this->curTime);
+    collectJobs(inst, this->curTime);
 }
 
 //------------------------------------------------------------------------------
 void
 animMgr::stopAll(animInstance* inst, bool allowFadeOut) {
     inst->sequencer.stopAll(this->curTime, allowFadeOut);
-    inst->sequencer.garbageCollect(this->curTime);
+    collectJobs(inst, this->curTime);
+}
+
+//------------------------------------------------------------------------------
+int
+animMgr::encodeState(animInstance* inst, uint8_t* dst, int maxBytes, const uint8_t* baseline, int baselineBytes) {
+    o_assert_dbg(inst);
+    collectJobs(inst, this->curTime);
+    if (baseline) {
+        animSequencer baseSequencer;
+        if (!baseSequencer.decode(baseline, baselineBytes, nullptr)) {
+            o_warn("Anim::EncodeState: invalid baseline (must be a non-delta encoding)\n");
+            return 0;
+        }
+        return inst->sequencer.encode(dst, maxBytes, &baseSequencer);
+    }
+    else {
+        return inst->sequencer.encode(dst, maxBytes, nullptr);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+animMgr::decodeState(animInstance* inst, const uint8_t* src, int numBytes, const uint8_t* baseline, int baselineBytes) {
+    o_assert_dbg(inst);
+    animSequencer baseSequencer;
+    if (baseline && !baseSequencer.decode(baseline, baselineBytes, nullptr)) {
+        o_warn("Anim::DecodeState: invalid baseline (must be a non-delta encoding)\n");
+        return false;
+    }
+    // decode into a temporary sequencer, the instance's state is only
+    // replaced if the decoded jobs are valid for the instance's library
+    animSequencer decoded;
+    if (!decoded.decode(src, numBytes, baseline ? &baseSequencer : nullptr)) {
+        return false;
+    }
+    AnimJobId maxJobId = 0;
+    for (const auto& item : decoded.items) {
+        if ((item.clipIndex < 0) || (item.clipIndex >= inst->library->Clips.Size()) || (InvalidAnimJobId == item.id)) {
+            o_warn("Anim::DecodeState: invalid clip index or job id in decoded state\n");
+            return false;
+        }
+        if (item.id > maxJobId) {
+            maxJobId = item.id;
+        }
+    }
+    inst->sequencer.items = decoded.items;
+    // job ids created after this must not collide with the decoded ones
+    if (maxJobId > this->curAnimJobId) {
+        this->curAnimJobId = maxJobId;
+    }
+    return true;
 }
 
 } // namespace _priv
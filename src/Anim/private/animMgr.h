@@ -9,6 +9,9 @@
 #include "Resource/ResourcePool.h"
 #include "Anim/AnimTypes.h"
 #include "Anim/private/animInstance.h"
+#include "Anim/private/animKeyCache.h"
+#include "Anim/private/animBlockAlloc.h"
+#include "Anim/private/animWorkerPool.h"
 
 namespace Oryol {
 namespace _priv {
@@ -30,41 +33,78 @@ public:
     Id createLibrary(const AnimLibrarySetup& setup);
     /// lookup pointer to an animation library
     AnimLibrary* lookupLibrary(const Id& resId);
-    /// destroy an animation library
+    /// destroy an animation library (its pool ranges are removed in compactPools)
     void destroyLibrary(const Id& resId);
+    /// swap clips and keys of a library in place, return false if the layout isn't compatible
+    bool reloadLibrary(AnimLibrary* lib, const AnimLibrarySetup& setup, const uint8_t* ptr, int numBytes);
+    /// setup the clips and curves of a library, with keys starting at keyIndex (called from createLibrary and reloadLibrary)
+    void initClips(AnimLibrary* lib, const AnimLibrarySetup& setup, int keyIndex);
 
     /// create a skeleton
     Id createSkeleton(const AnimSkeletonSetup& setup);
     /// lookup pointer to skeleton
     AnimSkeleton* lookupSkeleton(const Id& resId);
-    /// destroy a skeleton
+    /// destroy a skeleton (its pool ranges are removed in compactPools)
     void destroySkeleton(const Id& resId);
 
     /// create an animation instance
     Id createInstance(const AnimInstanceSetup& setup);
     /// lookup pointer to an animation instance
     animInstance* lookupInstance(const Id& resId);
+    /// create copies of an animation instance (including anim jobs), return number of created instances
+    int cloneInstances(const animInstance* src, int num, Id* outIds);
     /// destroy an animation instance
     void destroyInstance(const Id& resId);
 
     /// remove a range of keys from key pool and fixup indices in curves and clips
     void removeKeys(Slice<int16_t> keyRange);
-    /// remove a range of curves from curve pool, and fixup clips
-    void removeCurves(Slice<AnimCurve> curveRange);
-    /// remove a range of clips from clip pool, and fixup libraries
-    void removeClips(Slice<AnimClip> clipRange);
-    /// remove a range of matrices from the matrix pool
-    void removeMatrices(Slice<glm::mat4x3> matrixRange);
+    /// remove all collected gaps from the key and matrix pools in one pass per pool, and fixup the array views
+    void compactPools();
 
     /// write animition library keys
     void writeKeys(AnimLibrary* lib, const uint8_t* ptr, int numBytes);
+    /// build the per-clip root motion tables (called from writeKeys)
+    void initRootMotion(AnimLibrary* lib);
+    /// append a clip's Q16.16 root motion table (called from initRootMotion in AnimEvalMode::FixedPoint)
+    void initFixedRootMotion(AnimLibrary* lib, const AnimClip& clip);
+    /// build the (value, delta) key pairs of opted-in clips (called from writeKeys)
+    void initDeltaKeys(AnimLibrary* lib);
+    /// build the reduced-rate LOD keys of opted-in clips (called from writeKeys)
+    void initLodKeys(AnimLibrary* lib);
+    /// compress the keys into pose basis coefficients and release them (called from writeKeys)
+    void initPoseBasis(AnimLibrary* lib);
+    /// precompute local matrices of static bones (called from createLibrary)
+    void initStaticBones(AnimLibrary* lib);
+
+    /// bake the per-key skin matrices of a clip for a skeleton
+    bool bakeSkinMatrices(AnimLibrary* lib, int clipIndex, AnimSkeleton* skel);
+    /// sample a clip at a number of clip-relative times, distributed to worker threads
+    void sampleClip(const AnimLibrary* lib, int clipIndex, const double* times, int numTimes, float* out);
 
     /// begin a new frame, resets the active instances
     void newFrame();
-    /// add an active instance for the current frame
-    bool addActiveInstance(animInstance* inst);
+    /// select the most played clips and pre-decode their keys into the hot key pool (called from newFrame)
+    void updateHotClips();
+    /// remove the pre-decoded keys of a library's clips
+    void resetHotClips(AnimLibrary* lib);
+    /// remove the pre-decoded keys of a clip, and release them in the hot key pool
+    void demoteHotClip(AnimClip* clip);
+    /// add an active instance for the current frame, optionally with caller-owned output buffers and a clip LOD
+    bool addActiveInstance(animInstance* inst, float* samplesDst=nullptr, float* skinMatricesDst=nullptr, int lod=0);
+    /// merge the anim jobs of a leader into a follower (called from addActiveInstance)
+    void syncLeader(animInstance* inst, const animInstance* leader);
+    /// add a follower which shares the outputs of its leader (called from addActiveInstance)
+    void addSharedInstance(animInstance* inst, animInstance* leader);
     /// evaluate all active instances, and reset active instance array
     void evaluate(double frameDurationInSeconds);
+    /// decide which active instances need to be evaluated (called from evaluate)
+    void checkDirtyInstances();
+    /// update the dirty flags and ranges in skinMatrixInfo (called from evaluate)
+    void updateDirtyRanges();
+    /// sort the active instances by library, clip and skeleton (called from evaluate)
+    void sortActiveInstances();
+    /// sample the collected single-clip instances in groups (called from evaluate)
+    void evalSampleGroups();
 
     /// start an animation on an instance (active or inactive)
     AnimJobId play(animInstance* inst, const AnimJob& job);
@@ -75,17 +115,42 @@ public:
     /// stop all anim jobs
     void stopAll(animInstance* inst, bool allowFadeOut);
 
+    /// encode sequencer state of an instance, optionally as delta to an encoded baseline
+    int encodeState(animInstance* inst, uint8_t* dst, int maxBytes, const uint8_t* baseline, int baselineBytes);
+    /// decode sequencer state into an instance
+    bool decodeState(animInstance* inst, const uint8_t* src, int numBytes, const uint8_t* baseline, int baselineBytes);
+
     /// generate the skinning matrices for animInstance
     void genSkinMatrices(animInstance* inst);
+    /// same as genSkinMatrices, but with deterministic fixed-point math
+    void genSkinMatricesFixed(animInstance* inst);
+    /// generate skinning matrices for up to maxSkinGroupLanes instances sharing a skeleton
+    void genSkinMatricesGroup(const AnimSkeleton* skel, animInstance* const* insts, int num);
+    /// skin the collected instances in groups by skeleton (called from evaluate)
+    void evalSkinGroups();
+    /// interpolate baked skin matrices if the instance plays a single baked clip, return false otherwise
+    bool genSkinMatricesBaked(animInstance* inst);
 
     static const Id::TypeT resTypeLib = 1;
     static const Id::TypeT resTypeSkeleton = 2;
     static const Id::TypeT resTypeInstance = 3;
+    /// min number of sample times per worker thread in sampleClip()
+    static const int minSampleClipTimesPerThread = 64;
+    /// alignment of the skin matrix table, and of instances with streaming stores (a cache line)
+    static const int skinMatrixAlignment = 64;
+    /// number of instances processed in lockstep by genSkinMatricesGroup()
+    static const int maxSkinGroupLanes = 8;
+    /// number of frames between hot clip updates
+    static const int hotClipUpdateFrames = 60;
+    /// number of block power iterations to compute a pose basis
+    static const int poseBasisIterations = 8;
 
     AnimSetup animSetup;
     bool isValid = false;
     bool inFrame = false;
     double curTime = 0.0;
+    uint32_t frameIndex = 0;
+    uint32_t keysVersion = 0;
     uint32_t curAnimJobId = 0;
     ResourceContainerBase resContainer;
     ResourcePool<AnimLibrary> libPool;
@@ -93,8 +158,44 @@ public:
     ResourcePool<animInstance> instPool;
     Array<AnimClip> clipPool;
     Array<AnimCurve> curvePool;
+    animBlockAlloc clipBlocks;
+    animBlockAlloc curveBlocks;
     Array<glm::mat4x3> matrixPool;
     Array<animInstance*> activeInstances;
+    struct sortItem {
+        const AnimLibrary* library = nullptr;
+        int clipIndex = InvalidIndex;
+        const AnimSkeleton* skeleton = nullptr;
+        int index = 0;
+        animInstance* inst = nullptr;
+    };
+    Array<sortItem> sortItems;
+    struct sampleGroupItem {
+        const AnimLibrary* library = nullptr;
+        int clipIndex = InvalidIndex;
+        double clipTime = 0.0;
+        animInstance* inst = nullptr;
+    };
+    Array<sampleGroupItem> sampleGroupItems;
+    Array<animInstance*> skinGroupInstances;
+    Array<animInstance*> skinInfoInstances;
+    /// a range of removed pool items (collected until the next compactPools)
+    struct poolGap {
+        int offset = 0;
+        int size = 0;
+        /// accumulated size of this and all previous gaps
+        int shift = 0;
+    };
+    Array<poolGap> keyGaps;
+    Array<poolGap> matrixGaps;
+    animKeyCache keyCache;
+    animWorkerPool sampleWorkers;
+    Array<AnimClip*> hotClipCandidates;
+    /// clips with pre-decoded keys in the hot key pool
+    Array<AnimClip*> hotClips;
+    animBlockAlloc hotKeyBlocks;
+    float* hotKeyPool = nullptr;
+    float* skinGroupScratch = nullptr;
     AnimSkinMatrixInfo skinMatrixInfo;
     int numKeys = 0;
     Slice<int16_t> keys;
@@ -102,11 +203,15 @@ public:
     int numSamples = 0;
     Slice<float> samples;
     float* samplePool = nullptr;
+    int numFixedSamples = 0;
+    Slice<int32_t> fixedSamples;
+    int32_t* fixedSamplePool = nullptr;
     int curSkinMatrixTableX = 0;
     int curSkinMatrixTableY = 0;
     int skinMatrixTableStride = 0;  // in number of floats
     Slice<float> skinMatrixTable;
-    float* skinMatrixPool = nullptr;
+    float* skinMatrixPool = nullptr;    // aligned to skinMatrixAlignment
+    uint8_t* skinMatrixPoolAlloc = nullptr;
 };
 
 } // namespace _priv
@@ -3,6 +3,9 @@
 //------------------------------------------------------------------------------
 #include "Pre.h"
 #include "animSequencer.h"
+#include "animFixed.h"
+#include "animKeyCache.h"
+#include "Core/Memory/Memory.h"
 #include <float.h>
 #include <math.h>
 
@@ -54,7 +57,9 @@ animSequencer::add(double curTime, AnimJobId jobId, const AnimJob& job, double c
     newItem.valid = true;
     newItem.clipIndex = job.ClipIndex;
     newItem.trackIndex = job.TrackIndex;
-    newItem.mixWeight = job.MixWeight;
+    // clamp the weight so that float and fixed-point evaluation agree
+    newItem.mixWeight = job.MixWeight < 0.0f ? 0.0f : (job.MixWeight > 1.0f ? 1.0f : job.MixWeight);
+    newItem.mirror = job.Mirror;
     newItem.absStartTime = absStartTime;
     newItem.absFadeInTime = absStartTime + job.FadeIn;
     if (job.Duration > 0.0f) {
@@ -170,6 +175,313 @@ animSequencer::garbageCollect(double curTime) {
     }
 }
 
+//------------------------------------------------------------------------------
+//  Encoded sequencer state layout:
+//
+//  u8: number of items, bit 7 set if delta-encoded against a baseline
+//  per item:
+//      u8: field mask, a set bit means the field differs from the 
+//          reference item and follows in the byte stream
+//      u8: index of reference item in baseline, or 0xFF if new item
+//          (followed by varint job id), the reference item of a new
+//          item is a default-constructed item
+//      fields (in this order, only if bit in field mask is set):
+//          varint:     clip index
+//          zz-varint:  track index
+//          u16:        mix weight (1/32768 units)
+//          zz-varint:  delta of start time to ref item (ticks)
+//          zz-varint:  delta of fade-in time (rel. to start) to ref item
+//          zz-varint:  delta of fade-out time (rel. to start) to ref item
+//          zz-varint:  delta of end time (rel. to start) to ref item
+//      the last bit in the field mask has no payload, it toggles the
+//      mirror flag of the reference item
+//
+//  Invalid items are not encoded. Times are quantized to 
+//  1/encodeTicksPerSecond, infinite times (DBL_MAX) are encoded as a
+//  special tick value.
+//
+namespace {
+
+enum encodeField {
+    fieldClip       = (1<<0),
+    fieldTrack      = (1<<1),
+    fieldWeight     = (1<<2),
+    fieldStart      = (1<<3),
+    fieldFadeIn     = (1<<4),
+    fieldFadeOut    = (1<<5),
+    fieldEnd        = (1<<6),
+    fieldMirror     = (1<<7),
+};
+const uint8_t encodeNewItem = 0xFF;
+const uint8_t encodeDeltaBit = 0x80;
+const int64_t encodeInfiniteTicks = INT64_MAX;
+
+struct quantItem {
+    uint32_t clip = 0;
+    int32_t track = 0;
+    uint16_t weight = 0;
+    bool mirror = false;
+    // start time, and fade-in, fade-out, end time relative to start
+    int64_t ticks[4] = { };
+};
+
+} // anonymous namespace
+
+//------------------------------------------------------------------------------
+static int64_t
+toTicks(double t) {
+    if (t >= DBL_MAX) {
+        return encodeInfiniteTicks;
+    }
+    return int64_t(floor(t * animSequencer::encodeTicksPerSecond + 0.5));
+}
+
+//------------------------------------------------------------------------------
+static double
+fromTicks(int64_t t) {
+    if (encodeInfiniteTicks == t) {
+        return DBL_MAX;
+    }
+    return double(t) / animSequencer::encodeTicksPerSecond;
+}
+
+//------------------------------------------------------------------------------
+static int64_t
+toRelTicks(double t, int64_t startTicks) {
+    const int64_t ticks = toTicks(t);
+    return (encodeInfiniteTicks == ticks) ? ticks : ticks - startTicks;
+}
+
+//------------------------------------------------------------------------------
+static double
+fromRelTicks(int64_t t, int64_t startTicks) {
+    return (encodeInfiniteTicks == t) ? DBL_MAX : fromTicks(startTicks + t);
+}
+
+//------------------------------------------------------------------------------
+static quantItem
+quantize(const animSequencer::item& item) {
+    quantItem q;
+    q.clip = uint32_t(item.clipIndex);
+    q.track = item.trackIndex;
+    float w = floorf(item.mixWeight * 32768.0f + 0.5f);
+    if (w < 0.0f) w = 0.0f;
+    else if (w > 65535.0f) w = 65535.0f;
+    q.weight = uint16_t(w);
+    q.mirror = item.mirror;
+    q.ticks[0] = toTicks(item.absStartTime);
+    q.ticks[1] = toRelTicks(item.absFadeInTime, q.ticks[0]);
+    q.ticks[2] = toRelTicks(item.absFadeOutTime, q.ticks[0]);
+    q.ticks[3] = toRelTicks(item.absEndTime, q.ticks[0]);
+    return q;
+}
+
+//------------------------------------------------------------------------------
+static uint64_t
+zigzag(int64_t v) {
+    return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+//------------------------------------------------------------------------------
+static int64_t
+unzigzag(uint64_t v) {
+    return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+//------------------------------------------------------------------------------
+static bool
+putByte(uint8_t*& ptr, const uint8_t* end, uint8_t val) {
+    if (ptr >= end) {
+        return false;
+    }
+    *ptr++ = val;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static bool
+putVarint(uint8_t*& ptr, const uint8_t* end, uint64_t val) {
+    while (val >= 0x80) {
+        if (!putByte(ptr, end, uint8_t(val | 0x80))) {
+            return false;
+        }
+        val >>= 7;
+    }
+    return putByte(ptr, end, uint8_t(val));
+}
+
+//------------------------------------------------------------------------------
+static bool
+getByte(const uint8_t*& ptr, const uint8_t* end, uint8_t& val) {
+    if (ptr >= end) {
+        return false;
+    }
+    val = *ptr++;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static bool
+getVarint(const uint8_t*& ptr, const uint8_t* end, uint64_t& val) {
+    val = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t b;
+        if (!getByte(ptr, end, b)) {
+            return false;
+        }
+        val |= uint64_t(b & 0x7F) << shift;
+        if (0 == (b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+int
+animSequencer::encode(uint8_t* dst, int maxBytes, const animSequencer* baseline) const {
+    o_assert_dbg(dst && (maxBytes > 0));
+    uint8_t* ptr = dst;
+    const uint8_t* end = dst + maxBytes;
+    int numItems = 0;
+    for (const auto& item : this->items) {
+        if (item.valid) {
+            numItems++;
+        }
+    }
+    if (!putByte(ptr, end, uint8_t(numItems | (baseline ? encodeDeltaBit : 0)))) {
+        return 0;
+    }
+    const quantItem defaultItem = quantize(item());
+    for (const auto& item : this->items) {
+        if (!item.valid) {
+            continue;
+        }
+        // find reference item in baseline
+        uint8_t refIndex = encodeNewItem;
+        quantItem ref = defaultItem;
+        if (baseline) {
+            for (int i = 0; i < baseline->items.Size(); i++) {
+                if (baseline->items[i].valid && (baseline->items[i].id == item.id)) {
+                    refIndex = uint8_t(i);
+                    ref = quantize(baseline->items[i]);
+                    break;
+                }
+            }
+        }
+        const quantItem q = quantize(item);
+        uint8_t mask = 0;
+        if (q.clip != ref.clip) mask |= fieldClip;
+        if (q.track != ref.track) mask |= fieldTrack;
+        if (q.weight != ref.weight) mask |= fieldWeight;
+        if (q.mirror != ref.mirror) mask |= fieldMirror;
+        for (int i = 0; i < 4; i++) {
+            if (q.ticks[i] != ref.ticks[i]) mask |= (fieldStart << i);
+        }
+        bool ok = putByte(ptr, end, mask) && putByte(ptr, end, refIndex);
+        if (ok && (encodeNewItem == refIndex)) {
+            ok = putVarint(ptr, end, item.id);
+        }
+        if (ok && (mask & fieldClip)) {
+            ok = putVarint(ptr, end, q.clip);
+        }
+        if (ok && (mask & fieldTrack)) {
+            ok = putVarint(ptr, end, zigzag(q.track));
+        }
+        if (ok && (mask & fieldWeight)) {
+            ok = putByte(ptr, end, uint8_t(q.weight & 0xFF)) && putByte(ptr, end, uint8_t(q.weight >> 8));
+        }
+        for (int i = 0; ok && (i < 4); i++) {
+            if (mask & (fieldStart << i)) {
+                // wrap-around is intended here for the infinite tick value
+                ok = putVarint(ptr, end, zigzag(int64_t(uint64_t(q.ticks[i]) - uint64_t(ref.ticks[i]))));
+            }
+        }
+        if (!ok) {
+            return 0;
+        }
+    }
+    return int(ptr - dst);
+}
+
+//------------------------------------------------------------------------------
+bool
+animSequencer::decode(const uint8_t* src, int numBytes, const animSequencer* baseline) {
+    o_assert_dbg(src);
+    const uint8_t* ptr = src;
+    const uint8_t* end = src + numBytes;
+    uint8_t header;
+    if (!getByte(ptr, end, header)) {
+        return false;
+    }
+    const int numItems = header & ~encodeDeltaBit;
+    if ((numItems > maxItems) || ((0 != (header & encodeDeltaBit)) != (nullptr != baseline))) {
+        return false;
+    }
+    InlineArray<item, maxItems> decodedItems;
+    const quantItem defaultItem = quantize(item());
+    for (int itemIndex = 0; itemIndex < numItems; itemIndex++) {
+        uint8_t mask, refIndex;
+        if (!(getByte(ptr, end, mask) && getByte(ptr, end, refIndex))) {
+            return false;
+        }
+        item newItem;
+        quantItem q = defaultItem;
+        if (encodeNewItem == refIndex) {
+            uint64_t id;
+            if (!getVarint(ptr, end, id)) {
+                return false;
+            }
+            newItem.id = AnimJobId(id);
+        }
+        else {
+            if (!baseline || (refIndex >= baseline->items.Size())) {
+                return false;
+            }
+            newItem.id = baseline->items[refIndex].id;
+            q = quantize(baseline->items[refIndex]);
+        }
+        uint64_t val;
+        if (mask & fieldClip) {
+            if (!getVarint(ptr, end, val)) return false;
+            q.clip = uint32_t(val);
+        }
+        if (mask & fieldTrack) {
+            if (!getVarint(ptr, end, val)) return false;
+            q.track = int32_t(unzigzag(val));
+        }
+        if (mask & fieldWeight) {
+            uint8_t lo, hi;
+            if (!(getByte(ptr, end, lo) && getByte(ptr, end, hi))) return false;
+            q.weight = uint16_t(lo | (hi << 8));
+        }
+        if (mask & fieldMirror) {
+            q.mirror = !q.mirror;
+        }
+        for (int i = 0; i < 4; i++) {
+            if (mask & (fieldStart << i)) {
+                if (!getVarint(ptr, end, val)) return false;
+                q.ticks[i] = int64_t(uint64_t(q.ticks[i]) + uint64_t(unzigzag(val)));
+            }
+        }
+        newItem.valid = true;
+        newItem.clipIndex = int(q.clip);
+        newItem.trackIndex = q.track;
+        newItem.mixWeight = float(q.weight) / 32768.0f;
+        newItem.mirror = q.mirror;
+        newItem.absStartTime = fromTicks(q.ticks[0]);
+        newItem.absFadeInTime = fromRelTicks(q.ticks[1], q.ticks[0]);
+        newItem.absFadeOutTime = fromRelTicks(q.ticks[2], q.ticks[0]);
+        newItem.absEndTime = fromRelTicks(q.ticks[3], q.ticks[0]);
+        decodedItems.Add(newItem);
+    }
+    if (ptr != end) {
+        return false;
+    }
+    this->items = decodedItems;
+    return true;
+}
+
 //------------------------------------------------------------------------------
 static float fadeWeight(float w0, float w1, double t, double t0, double t1) {
     // compute a fade-in or fade-out mixing weight
@@ -183,6 +495,16 @@ static float fadeWeight(float w0, float w1, double t, double t0, double t1) {
     return w0 + rt*(w1-w0);
 }
 
+//------------------------------------------------------------------------------
+static int32_t fadeWeightFixed(int32_t w0, int32_t w1, double t, double t0, double t1) {
+    // fixed-point version of fadeWeight(), the weights are Q1.15
+    double dt = t1 - t0;
+    if ((dt > -0.000001) && (dt < 0.000001)) {
+        return w0;
+    }
+    return animFixed::lerp(w0, w1, animFixed::fromUnit((t - t0) / dt));
+}
+
 //------------------------------------------------------------------------------
 static int clampKeyIndex(int keyIndex, int clipNumKeys) {
     // FIXME: handle clamp vs loop here
@@ -200,117 +522,1039 @@ static float unpack(int16_t p, float m) {
 }
 
 //------------------------------------------------------------------------------
-bool
-animSequencer::eval(const AnimLibrary* lib, double curTime, float* sampleBuffer, int numSamples) {
+static bool isActive(const animSequencer::item& item, double curTime) {
+    return item.valid && (item.absStartTime <= curTime) && (item.absEndTime > curTime);
+}
 
-    // for each item which crosses the current play time...
-    // FIXME: currently items are evaluated even if they are culled
-    // completely by higher priority items
-    int numProcessedItems = 0;
-    for (const auto& item : this->items) {
-        // skip current item if it isn't valid or doesn't cross the play cursor
-        if (!item.valid || (item.absStartTime > curTime) || (item.absEndTime <= curTime)) {
+//------------------------------------------------------------------------------
+static bool isExpiring(const animSequencer::item& item, double prevTime, double curTime) {
+    // an item which ended between prevTime and curTime
+    return item.valid && (item.absEndTime > prevTime) && (item.absEndTime <= curTime) && (item.absStartTime < item.absEndTime);
+}
+
+//------------------------------------------------------------------------------
+static float itemWeight(const animSequencer::item& item, double curTime) {
+    // compute the mixing weight of an item, including fade-in/out
+    float weight = item.mixWeight;
+    if (curTime < item.absFadeInTime) {
+        weight = fadeWeight(0.0f, weight, curTime, item.absStartTime, item.absFadeInTime);
+    }
+    else if (curTime > item.absFadeOutTime) {
+        weight = fadeWeight(weight, 0.0f, curTime, item.absFadeOutTime, item.absEndTime);
+    }
+    return weight;
+}
+
+//------------------------------------------------------------------------------
+static int32_t itemWeightFixed(const animSequencer::item& item, double curTime) {
+    // fixed-point version of itemWeight(), the weight is Q1.15
+    int32_t weight = animFixed::fromUnit(item.mixWeight);
+    if (curTime < item.absFadeInTime) {
+        weight = fadeWeightFixed(0, weight, curTime, item.absStartTime, item.absFadeInTime);
+    }
+    else if (curTime > item.absFadeOutTime) {
+        weight = fadeWeightFixed(weight, 0, curTime, item.absFadeOutTime, item.absEndTime);
+    }
+    return weight;
+}
+
+//------------------------------------------------------------------------------
+static float itemWeightVelocity(const animSequencer::item& item, double curTime) {
+    // compute the derivative of itemWeight() over time (non-zero only while fading)
+    if (curTime < item.absFadeInTime) {
+        const double dt = item.absFadeInTime - item.absStartTime;
+        if ((dt > 0.000001) && (curTime > item.absStartTime)) {
+            return float(item.mixWeight / dt);
+        }
+    }
+    else if (curTime > item.absFadeOutTime) {
+        const double dt = item.absEndTime - item.absFadeOutTime;
+        if ((dt > 0.000001) && (curTime < item.absEndTime)) {
+            return float(-item.mixWeight / dt);
+        }
+    }
+    return 0.0f;
+}
+
+//------------------------------------------------------------------------------
+static bool
+isMirrored(const animSequencer::item& item, const AnimLibrary* lib, const AnimSkeleton* skel) {
+    // mirroring needs a mirror map and a per-bone curve layout
+    return item.mirror && skel && (lib->NumBones > 0);
+}
+
+//------------------------------------------------------------------------------
+template<class TYPE> static void
+mirrorSamples(const AnimLibrary* lib, const AnimSkeleton* skel, TYPE* smp) {
+    // mirror a (translate, rotate, scale) per-bone pose in place, the
+    // samples of mirrored bone pairs are swapped, the translation 
+    // component along the mirror axis and the rotation axis components
+    // perpendicular to the mirror axis are negated
+    const int numBones = lib->NumBones < skel->NumBones ? lib->NumBones : skel->NumBones;
+    const int axis = skel->MirrorAxis;
+    for (int bone = 0; bone < numBones; bone++) {
+        const int mirrorBone = skel->MirrorIndices[bone];
+        if ((mirrorBone < bone) || (mirrorBone >= numBones)) {
+            // pair has already been handled, or isn't in the library
             continue;
         }
-        const AnimClip& clip = lib->Clips[item.clipIndex];
+        TYPE* s0 = smp + bone * 10;
+        TYPE* s1 = smp + mirrorBone * 10;
+        for (int i = 0; i < 10; i++) {
+            TYPE v0 = s0[i];
+            TYPE v1 = s1[i];
+            const bool negate = (i < 3) ? (i == axis) : ((i < 6) && ((i - 3) != axis));
+            if (negate) {
+                v0 = -v0;
+                v1 = -v1;
+            }
+            s0[i] = v1;
+            s1[i] = v0;
+        }
+    }
+}
 
-        // compute sampling parameters
-        int key0 = 0;
-        int key1 = 0;
-        float keyPos = 0.0f;
-        if (clip.Length > 0) {
-            o_assert_dbg(clip.KeyDuration > 0.0f);
-            const double clipTime = curTime - item.absStartTime;
-            key0 = int(clipTime / clip.KeyDuration);
-            keyPos = float((clipTime - (key0 * clip.KeyDuration)) / clip.KeyDuration);
-            key0 = clampKeyIndex(key0, clip.Length);
-            key1 = clampKeyIndex(key0 + 1, clip.Length);
-        }
-
-        // only sample, or sample and mix with previous track?
-        const int16_t* src0 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key0 * clip.KeyStride]);
-        const int16_t* src1 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key1 * clip.KeyStride]);
-        float* dst = sampleBuffer;
-        #if ORYOL_DEBUG
-        const float* dstEnd = dst + numSamples;
-        #endif
-        float s0, s1, v0, v1;
-        if (0 == numProcessedItems) {
-            // first processed track, only need to sample, not mix with previous track
-            for (const auto& curve : clip.Curves) {
-                const int num = curve.NumValues;
-                if (curve.Static) {
-                    if (num >= 1) *dst++ = curve.StaticValue[0];
-                    if (num >= 2) *dst++ = curve.StaticValue[1];
-                    if (num >= 3) *dst++ = curve.StaticValue[2];
-                    if (num >= 4) *dst++ = curve.StaticValue[3];
+//------------------------------------------------------------------------------
+static void
+sampleParams(const AnimClip& clip, double clipTime, int& key0, int& key1, double& keyPos) {
+    // compute the 2 keys to sample, and the relative position between them
+    key0 = 0;
+    key1 = 0;
+    keyPos = 0.0;
+    if (clip.Length > 0) {
+        o_assert_dbg(clip.KeyDuration > 0.0f);
+        key0 = int(clipTime / clip.KeyDuration);
+        keyPos = (clipTime - (key0 * clip.KeyDuration)) / clip.KeyDuration;
+        key0 = clampKeyIndex(key0, clip.Length);
+        key1 = clampKeyIndex(key0 + 1, clip.Length);
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+snapToKey(const AnimClip& clip, int& key0, int& key1, double& keyPos) {
+    // if the position rounds to the next key, snap to the next key, so
+    // that sampling at a key time which isn't exactly representable
+    // yields the key values (only done by the stateless sample functions)
+    if ((clip.Length > 0) && (float(keyPos) >= 1.0f)) {
+        key0 = key1;
+        key1 = clampKeyIndex(key0 + 1, clip.Length);
+        keyPos = 0.0;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleKeyRows(const AnimClip& clip, const int16_t* row0, const int16_t* row1, float keyPos, float* dst) {
+    const int16_t* src0 = row0;
+    const int16_t* src1 = row1;
+    float v0, v1;
+    for (const auto& curve : clip.Curves) {
+        const int num = curve.NumValues;
+        if (curve.Static) {
+            if (num >= 1) *dst++ = curve.StaticValue[0];
+            if (num >= 2) *dst++ = curve.StaticValue[1];
+            if (num >= 3) *dst++ = curve.StaticValue[2];
+            if (num >= 4) *dst++ = curve.StaticValue[3];
+        }
+        else {
+            // NOTE: simply use linear interpolation for quaternions,
+            // just assume they are close together
+            const float* m = curve.Magnitude;
+            if (num >= 1) { v0=unpack(*src0++,m[0]); v1=unpack(*src1++,m[0]); *dst++=v0+(v1-v0)*keyPos; }
+            if (num >= 2) { v0=unpack(*src0++,m[1]); v1=unpack(*src1++,m[1]); *dst++=v0+(v1-v0)*keyPos; }
+            if (num >= 3) { v0=unpack(*src0++,m[2]); v1=unpack(*src1++,m[2]); *dst++=v0+(v1-v0)*keyPos; }
+            if (num >= 4) { v0=unpack(*src0++,m[3]); v1=unpack(*src1++,m[3]); *dst++=v0+(v1-v0)*keyPos; }
+        }
+    }
+    #if ORYOL_DEBUG
+    if (src0 && src1) {
+        o_assert_dbg(src0 == (row0 + clip.KeyStride));
+        o_assert_dbg(src1 == (row1 + clip.KeyStride));
+    }
+    #endif
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleKeys(const AnimClip& clip, int key0, int key1, float keyPos, float* dst) {
+    const int16_t* src0 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key0 * clip.KeyStride]);
+    const int16_t* src1 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key1 * clip.KeyStride]);
+    sampleKeyRows(clip, src0, src1, keyPos, dst);
+}
+
+//------------------------------------------------------------------------------
+static int
+clipLod(const AnimClip& clip, int lod) {
+    // clamp a requested LOD to the LODs the clip actually has
+    return lod < clip.NumLods ? lod : clip.NumLods;
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleLodParams(const AnimClip& clip, int lod, double clipTime, int& key0, int& key1, double& keyPos) {
+    // same as sampleParams for a reduced-rate LOD of the clip, which
+    // has every (1<<lod)-th key, the last segment wraps around to the
+    // first key and is shorter if the clip length isn't a multiple
+    // of the step, so that looping stays exact
+    o_assert_dbg((lod > 0) && (lod <= clip.NumLods));
+    const int step = 1 << lod;
+    const int lodLength = (clip.Length + step - 1) / step;
+    const double clipDuration = clip.Length * clip.KeyDuration;
+    double loopTime = fmod(clipTime, clipDuration);
+    if (loopTime < 0.0) {
+        loopTime += clipDuration;
+    }
+    key0 = int(loopTime / (clip.KeyDuration * step));
+    if (key0 >= lodLength) {
+        key0 = lodLength - 1;
+    }
+    const int segmentKeys = (clip.Length - key0 * step) < step ? (clip.Length - key0 * step) : step;
+    keyPos = (loopTime - key0 * step * clip.KeyDuration) / (segmentKeys * clip.KeyDuration);
+    if (keyPos < 0.0) keyPos = 0.0;
+    else if (keyPos > 1.0) keyPos = 1.0;
+    key1 = (key0 + 1) % lodLength;
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleLodKeys(const AnimClip& clip, int lod, double clipTime, float* dst) {
+    int key0, key1;
+    double keyPos;
+    sampleLodParams(clip, lod, clipTime, key0, key1, keyPos);
+    const int16_t* keys = clip.LodKeys[lod - 1];
+    sampleKeyRows(clip, keys + key0 * clip.KeyStride, keys + key1 * clip.KeyStride, float(keyPos), dst);
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleRows(const AnimClip& clip, const float* row0, const float* row1, float keyPos, float* dst) {
+    // same as sampleKeys, but with already decoded float key rows
+    for (const auto& curve : clip.Curves) {
+        const int num = curve.NumValues;
+        if (curve.Static) {
+            for (int i = 0; i < num; i++) {
+                *dst++ = curve.StaticValue[i];
+            }
+        }
+        else {
+            for (int i = 0; i < num; i++) {
+                const float v0 = *row0++;
+                const float v1 = *row1++;
+                *dst++ = v0 + (v1 - v0) * keyPos;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleDeltaKeys(const AnimClip& clip, int key0, float keyPos, float* dst) {
+    // sample from (value, delta to next key) pairs, key1 is implicit
+    const float* src = clip.DeltaKeys + key0 * clip.KeyStride * 2;
+    for (const auto& curve : clip.Curves) {
+        const int num = curve.NumValues;
+        if (curve.Static) {
+            for (int i = 0; i < num; i++) {
+                *dst++ = curve.StaticValue[i];
+            }
+        }
+        else {
+            for (int i = 0; i < num; i++, src += 2) {
+                *dst++ = src[0] + src[1] * keyPos;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+samplePose(const AnimClip& clip, int key0, int key1, float keyPos, float* dst, float* vel) {
+    // reconstruct the samples from the clip's pose basis coefficients,
+    // the reconstruction is linear, so the coefficients are interpolated
+    // first, and the samples are a single matrix-vector product 
+    // (mean + basis * coeffs), static curves are restored exactly
+    const int numCoeffs = clip.PoseBasisSize;
+    const float* c0 = clip.PoseCoeffs + key0 * numCoeffs;
+    const float* c1 = clip.PoseCoeffs + key1 * numCoeffs;
+    const float invKeyDuration = clip.KeyDuration > 0.0f ? 1.0f / clip.KeyDuration : 0.0f;
+    float coeffs[AnimConfig::MaxPoseBasisSize];
+    float deltas[AnimConfig::MaxPoseBasisSize];
+    for (int k = 0; k < numCoeffs; k++) {
+        deltas[k] = c1[k] - c0[k];
+        coeffs[k] = c0[k] + deltas[k] * keyPos;
+        deltas[k] *= invKeyDuration;
+    }
+    int numValues = 0;
+    for (const auto& curve : clip.Curves) {
+        numValues += curve.NumValues;
+    }
+    const float* mean = clip.PoseBasis;
+    for (int i = 0; i < numValues; i++) {
+        dst[i] = mean[i];
+    }
+    if (vel) {
+        for (int i = 0; i < numValues; i++) {
+            vel[i] = 0.0f;
+        }
+    }
+    for (int k = 0; k < numCoeffs; k++) {
+        const float* basis = clip.PoseBasis + (k + 1) * numValues;
+        const float c = coeffs[k];
+        for (int i = 0; i < numValues; i++) {
+            dst[i] += basis[i] * c;
+        }
+        if (vel) {
+            const float d = deltas[k];
+            for (int i = 0; i < numValues; i++) {
+                vel[i] += basis[i] * d;
+            }
+        }
+    }
+    for (const auto& curve : clip.Curves) {
+        const int num = curve.NumValues;
+        if (curve.Static) {
+            for (int i = 0; i < num; i++) {
+                dst[i] = curve.StaticValue[i];
+                if (vel) {
+                    vel[i] = 0.0f;
                 }
-                else {
-                    // NOTE: simply use linear interpolation for quaternions,
-                    // just assume they are close together
-                    const float* m = curve.Magnitude;
-                    if (num >= 1) { v0=unpack(*src0++,m[0]); v1=unpack(*src1++,m[0]); *dst++=v0+(v1-v0)*keyPos; }
-                    if (num >= 2) { v0=unpack(*src0++,m[1]); v1=unpack(*src1++,m[1]); *dst++=v0+(v1-v0)*keyPos; }
-                    if (num >= 3) { v0=unpack(*src0++,m[2]); v1=unpack(*src1++,m[2]); *dst++=v0+(v1-v0)*keyPos; }
-                    if (num >= 4) { v0=unpack(*src0++,m[3]); v1=unpack(*src1++,m[3]); *dst++=v0+(v1-v0)*keyPos; }
+            }
+        }
+        dst += num;
+        if (vel) {
+            vel += num;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleKeysCached(const AnimClip& clip, int key0, int key1, float keyPos, float* dst, animKeyCache* keyCache) {
+    // sample from the (value, delta) pairs if the clip has them, or from
+    // the pose basis, or the pre-decoded keys of hot clips, or the 
+    // decoded key cache, or fall back to unpacking the keys
+    if (clip.DeltaKeys) {
+        sampleDeltaKeys(clip, key0, keyPos, dst);
+        return;
+    }
+    if (clip.PoseCoeffs) {
+        samplePose(clip, key0, key1, keyPos, dst, nullptr);
+        return;
+    }
+    if (clip.HotKeys) {
+        sampleRows(clip, clip.HotKeys + key0 * clip.KeyStride, clip.HotKeys + key1 * clip.KeyStride, keyPos, dst);
+        return;
+    }
+    if (keyCache) {
+        const float* row1 = keyCache->lookup(clip, key1);
+        const float* row0 = keyCache->lookup(clip, key0);
+        // both rows may map to the same cache slot
+        if (row0 && keyCache->isCached(clip, key1)) {
+            sampleRows(clip, row0, row1, keyPos, dst);
+            return;
+        }
+    }
+    sampleKeys(clip, key0, key1, keyPos, dst);
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleKeyRowsVelocity(const AnimClip& clip, const int16_t* src0, const int16_t* src1, const float* row0, const float* row1, float keyPos, float invDuration, float* dst, float* vel) {
+    // same as sampleKeyRows or sampleRows (if the float rows are given), but
+    // also writes the velocity (per second) of each value, which is the
+    // slope between the 2 keys, invDuration is 1 / the time between the keys
+    float v0, v1;
+    for (const auto& curve : clip.Curves) {
+        const int num = curve.NumValues;
+        if (curve.Static) {
+            for (int i = 0; i < num; i++) {
+                *dst++ = curve.StaticValue[i];
+                *vel++ = 0.0f;
+            }
+        }
+        else if (row0) {
+            for (int i = 0; i < num; i++) {
+                v0 = *row0++;
+                v1 = *row1++;
+                *dst++ = v0 + (v1 - v0) * keyPos;
+                *vel++ = (v1 - v0) * invDuration;
+            }
+        }
+        else {
+            const float* m = curve.Magnitude;
+            for (int i = 0; i < num; i++) {
+                v0 = unpack(*src0++, m[i]);
+                v1 = unpack(*src1++, m[i]);
+                *dst++ = v0 + (v1 - v0) * keyPos;
+                *vel++ = (v1 - v0) * invDuration;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleKeysVelocity(const AnimClip& clip, int key0, int key1, float keyPos, float* dst, float* vel, animKeyCache* keyCache) {
+    // same as sampleKeysCached, but also writes the velocities
+    const float invKeyDuration = clip.KeyDuration > 0.0f ? 1.0f / clip.KeyDuration : 0.0f;
+    if (clip.DeltaKeys) {
+        const float* delta = clip.DeltaKeys + key0 * clip.KeyStride * 2;
+        for (const auto& curve : clip.Curves) {
+            const int num = curve.NumValues;
+            if (curve.Static) {
+                for (int i = 0; i < num; i++) {
+                    *dst++ = curve.StaticValue[i];
+                    *vel++ = 0.0f;
+                }
+            }
+            else {
+                for (int i = 0; i < num; i++, delta += 2) {
+                    *dst++ = delta[0] + delta[1] * keyPos;
+                    *vel++ = delta[1] * invKeyDuration;
                 }
             }
         }
+        return;
+    }
+    if (clip.PoseCoeffs) {
+        samplePose(clip, key0, key1, keyPos, dst, vel);
+        return;
+    }
+    if (clip.HotKeys) {
+        const float* row0 = clip.HotKeys + key0 * clip.KeyStride;
+        const float* row1 = clip.HotKeys + key1 * clip.KeyStride;
+        sampleKeyRowsVelocity(clip, nullptr, nullptr, row0, row1, keyPos, invKeyDuration, dst, vel);
+        return;
+    }
+    if (keyCache) {
+        const float* row1 = keyCache->lookup(clip, key1);
+        const float* row0 = keyCache->lookup(clip, key0);
+        // both rows may map to the same cache slot
+        if (row0 && keyCache->isCached(clip, key1)) {
+            sampleKeyRowsVelocity(clip, nullptr, nullptr, row0, row1, keyPos, invKeyDuration, dst, vel);
+            return;
+        }
+    }
+    const int16_t* src0 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key0 * clip.KeyStride]);
+    const int16_t* src1 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key1 * clip.KeyStride]);
+    sampleKeyRowsVelocity(clip, src0, src1, nullptr, nullptr, keyPos, invKeyDuration, dst, vel);
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleLodKeysVelocity(const AnimClip& clip, int lod, double clipTime, float* dst, float* vel) {
+    // same as sampleLodKeys, but also writes the velocities, the
+    // last LOD segment may be shorter than the others
+    int key0, key1;
+    double keyPos;
+    sampleLodParams(clip, lod, clipTime, key0, key1, keyPos);
+    const int step = 1 << lod;
+    const int segmentKeys = (clip.Length - key0 * step) < step ? (clip.Length - key0 * step) : step;
+    const float invDuration = 1.0f / float(segmentKeys * clip.KeyDuration);
+    const int16_t* keys = clip.LodKeys[lod - 1];
+    sampleKeyRowsVelocity(clip, keys + key0 * clip.KeyStride, keys + key1 * clip.KeyStride, nullptr, nullptr, float(keyPos), invDuration, dst, vel);
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleKeysFixed(const AnimClip& clip, int key0, int key1, int32_t keyPos, int32_t* dst) {
+    const int16_t* src0 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key0 * clip.KeyStride]);
+    const int16_t* src1 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key1 * clip.KeyStride]);
+    for (const auto& curve : clip.Curves) {
+        const int num = curve.NumValues;
+        if (curve.Static) {
+            for (int i = 0; i < num; i++) {
+                *dst++ = curve.FixedStaticValue[i];
+            }
+        }
         else {
-            // evaluate track and mix with previous sampling+mixing result
-            // FIXME: may need to do proper quaternion slerp when mixing
-            // rotation curves
-            float weight = item.mixWeight;
-            if (curTime < item.absFadeInTime) {
-                weight = fadeWeight(0.0f, weight, curTime, item.absStartTime, item.absFadeInTime);
+            for (int i = 0; i < num; i++) {
+                *dst++ = animFixed::unpackLerp(*src0++, *src1++, keyPos, curve.FixedMagnitude[i]);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animSequencer::keyParams(const AnimClip& clip, double clipTime, int& key0, int& key1, double& keyPos) {
+    sampleParams(clip, clipTime, key0, key1, keyPos);
+}
+
+//------------------------------------------------------------------------------
+void
+animSequencer::sample(const AnimClip& clip, double clipTime, float* sampleBuffer, int numSamples) {
+    int key0, key1;
+    double keyPos;
+    sampleParams(clip, clipTime, key0, key1, keyPos);
+    snapToKey(clip, key0, key1, keyPos);
+    sampleKeysCached(clip, key0, key1, float(keyPos), sampleBuffer, nullptr);
+}
+
+//------------------------------------------------------------------------------
+void
+animSequencer::sampleFixed(const AnimClip& clip, double clipTime, float* sampleBuffer, int numSamples) {
+    o_assert_dbg(numSamples <= AnimConfig::MaxNumCurvesInClip * 4);
+    int key0, key1;
+    double keyPos;
+    sampleParams(clip, clipTime, key0, key1, keyPos);
+    snapToKey(clip, key0, key1, keyPos);
+    int32_t smp[AnimConfig::MaxNumCurvesInClip * 4];
+    sampleKeysFixed(clip, key0, key1, animFixed::fromUnit(keyPos), smp);
+    for (int i = 0; i < numSamples; i++) {
+        sampleBuffer[i] = animFixed::toFloat(smp[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animSequencer::sampleCached(const AnimClip& clip, double clipTime, float* sampleBuffer, animKeyCache* keyCache) {
+    int key0, key1;
+    double keyPos;
+    sampleParams(clip, clipTime, key0, key1, keyPos);
+    sampleKeysCached(clip, key0, key1, float(keyPos), sampleBuffer, keyCache);
+}
+
+//------------------------------------------------------------------------------
+void
+animSequencer::sampleGroup(const AnimClip& clip, const double* clipTimes, float* const* sampleBuffers, int num, animKeyCache* keyCache) {
+    // this samples the same clip for a group of instances, but unlike
+    // sampleKeys(), the inner loop goes over the instances, so that
+    // the key fetches become gathers and the unpack+lerp is vectorized
+    // across instances
+    if (clip.PoseCoeffs || clip.DeltaKeys) {
+        // pose basis and delta key clips have no key rows to gather
+        for (int i = 0; i < num; i++) {
+            sampleCached(clip, clipTimes[i], sampleBuffers[i], keyCache);
+        }
+        return;
+    }
+    const int16_t* keys = clip.Keys.begin();
+    for (int base = 0; base < num; base += maxSampleGroupLanes) {
+        const int numLanes = (num - base) < maxSampleGroupLanes ? (num - base) : maxSampleGroupLanes;
+        float* const* dst = sampleBuffers + base;
+        int key0[maxSampleGroupLanes];
+        int key1[maxSampleGroupLanes];
+        float keyPos[maxSampleGroupLanes];
+        const float* rows0[maxSampleGroupLanes];
+        const float* rows1[maxSampleGroupLanes];
+        float lanes[maxSampleGroupLanes];
+        for (int lane = 0; lane < numLanes; lane++) {
+            double pos;
+            sampleParams(clip, clipTimes[base + lane], key0[lane], key1[lane], pos);
+            keyPos[lane] = float(pos);
+            rows0[lane] = nullptr;
+            rows1[lane] = nullptr;
+            if (clip.HotKeys) {
+                rows0[lane] = clip.HotKeys + key0[lane] * clip.KeyStride;
+                rows1[lane] = clip.HotKeys + key1[lane] * clip.KeyStride;
             }
-            else if (curTime > item.absFadeOutTime) {
-                weight = fadeWeight(weight, 0.0f, curTime, item.absFadeOutTime, item.absEndTime);
+            else if (keyCache) {
+                rows1[lane] = keyCache->lookup(clip, key1[lane]);
+                rows0[lane] = keyCache->lookup(clip, key0[lane]);
+            }
+        }
+        // lanes gather from the same decoded float rows as eval() if
+        // they have them, the cached rows of a lane may have been evicted
+        // by the lookups of later lanes, those lanes unpack the keys
+        int rowLanes[maxSampleGroupLanes];
+        int keyLanes[maxSampleGroupLanes];
+        int numRowLanes = 0;
+        int numKeyLanes = 0;
+        for (int lane = 0; lane < numLanes; lane++) {
+            const bool hasRows = rows0[lane] && rows1[lane] &&
+                (clip.HotKeys || (keyCache->isCached(clip, key0[lane]) && keyCache->isCached(clip, key1[lane])));
+            if (hasRows) {
+                rowLanes[numRowLanes++] = lane;
             }
-            for (const auto& curve : clip.Curves) {
-                const int num = curve.NumValues;
+            else {
+                keyLanes[numKeyLanes++] = lane;
+                rows0[lane] = nullptr;
+                rows1[lane] = nullptr;
+            }
+        }
+        int sampleIndex = 0;
+        int keyIndex = 0;
+        for (const auto& curve : clip.Curves) {
+            for (int i = 0; i < curve.NumValues; i++, sampleIndex++) {
                 if (curve.Static) {
-                    if (num >= 1) { s0=*dst; s1=curve.StaticValue[0]; *dst++=s0+(s1-s0)*weight; }
-                    if (num >= 2) { s0=*dst; s1=curve.StaticValue[1]; *dst++=s0+(s1-s0)*weight; }
-                    if (num >= 3) { s0=*dst; s1=curve.StaticValue[2]; *dst++=s0+(s1-s0)*weight; }
-                    if (num >= 4) { s0=*dst; s1=curve.StaticValue[3]; *dst++=s0+(s1-s0)*weight; }
+                    const float v = curve.StaticValue[i];
+                    for (int lane = 0; lane < numLanes; lane++) {
+                        dst[lane][sampleIndex] = v;
+                    }
                 }
                 else {
-                    const float* m = curve.Magnitude;
-                    if (num >= 1) {
-                        v0=unpack(*src0++,m[0]); v1=unpack(*src1++,m[0]);
-                        s0=*dst; s1=v0+(v1-v0)*keyPos;
-                        *dst++=s0+(s1-s0)*weight;
+                    for (int j = 0; j < numRowLanes; j++) {
+                        const int lane = rowLanes[j];
+                        const float v0 = rows0[lane][keyIndex];
+                        const float v1 = rows1[lane][keyIndex];
+                        lanes[lane] = v0 + (v1 - v0) * keyPos[lane];
                     }
-                    if (num >= 2) {
-                        v0=unpack(*src0++,m[1]); v1=unpack(*src1++,m[1]);
-                        s0=*dst; s1=v0+(v1-v0)*keyPos;
-                        *dst++=s0+(s1-s0)*weight;
+                    const float m = curve.Magnitude[i];
+                    for (int j = 0; j < numKeyLanes; j++) {
+                        const int lane = keyLanes[j];
+                        const float v0 = unpack(keys[key0[lane] * clip.KeyStride + keyIndex], m);
+                        const float v1 = unpack(keys[key1[lane] * clip.KeyStride + keyIndex], m);
+                        lanes[lane] = v0 + (v1 - v0) * keyPos[lane];
                     }
-                    if (num >= 3) {
-                        v0=unpack(*src0++,m[2]); v1=unpack(*src1++,m[2]);
-                        s0=*dst; s1=v0+(v1-v0)*keyPos;
-                        *dst++=s0+(s1-s0)*weight;
-                    }
-                    if (num >= 4) {
-                        v0=unpack(*src0++,m[3]); v1=unpack(*src1++,m[3]);
-                        s0=*dst; s1=v0+(v1-v0)*keyPos;
-                        *dst++=s0+(s1-s0)*weight;
+                    for (int lane = 0; lane < numLanes; lane++) {
+                        dst[lane][sampleIndex] = lanes[lane];
                     }
+                    keyIndex++;
                 }
             }
         }
-        o_assert_dbg(dst == dstEnd);
-        #if ORYOL_DEBUG
-        if (src0 && src1) {
-            o_assert_dbg(src0 == (&(clip.Keys[key0 * clip.KeyStride]) + clip.KeyStride));
-            o_assert_dbg(src1 == (&(clip.Keys[key1 * clip.KeyStride]) + clip.KeyStride));
+        o_assert_dbg(keyIndex == clip.KeyStride);
+    }
+}
+
+//------------------------------------------------------------------------------
+const animSequencer::item*
+animSequencer::singleActiveItem(double curTime) const {
+    const item* activeItem = nullptr;
+    for (const auto& item : this->items) {
+        if (isActive(item, curTime)) {
+            if (activeItem) {
+                return nullptr;
+            }
+            activeItem = &item;
+        }
+    }
+    return activeItem;
+}
+
+//------------------------------------------------------------------------------
+static void
+hashBytes(uint64_t& hash, const void* ptr, int num) {
+    // FNV-1a
+    const uint8_t* bytes = (const uint8_t*) ptr;
+    for (int i = 0; i < num; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+}
+
+//------------------------------------------------------------------------------
+uint64_t
+animSequencer::evalSignature(const AnimLibrary* lib, double curTime, int lod, uint64_t hash) const {
+    // hash everything eval() and evalFixed() depend on, so that
+    // an unchanged signature means an unchanged evaluation result
+    int numProcessedItems = 0;
+    for (const auto& item : this->items) {
+        if (!isActive(item, curTime)) {
+            continue;
+        }
+        const AnimClip& clip = lib->Clips[item.clipIndex];
+        int key0, key1;
+        double keyPos;
+        const int clipLodIndex = clipLod(clip, lod);
+        if (clipLodIndex > 0) {
+            sampleLodParams(clip, clipLodIndex, curTime - item.absStartTime, key0, key1, keyPos);
+        }
+        else {
+            sampleParams(clip, curTime - item.absStartTime, key0, key1, keyPos);
+        }
+        hashBytes(hash, &item.clipIndex, sizeof(item.clipIndex));
+        hashBytes(hash, &clipLodIndex, sizeof(clipLodIndex));
+        const bool mirrored = isMirrored(item, lib, this->mirrorSkeleton);
+        hashBytes(hash, &mirrored, sizeof(mirrored));
+        if (clip.KeyStride > 0) {
+            // the result of clips without animated curves doesn't depend on the play time
+            hashBytes(hash, &key0, sizeof(key0));
+            hashBytes(hash, &key1, sizeof(key1));
+            hashBytes(hash, &keyPos, sizeof(keyPos));
+        }
+        if (numProcessedItems > 0) {
+            const float weight = itemWeight(item, curTime);
+            hashBytes(hash, &weight, sizeof(weight));
+        }
+        numProcessedItems++;
+    }
+    hashBytes(hash, &numProcessedItems, sizeof(numProcessedItems));
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+int
+animSequencer::firstActiveClip(double curTime) const {
+    for (const auto& item : this->items) {
+        if (isActive(item, curTime)) {
+            return item.clipIndex;
+        }
+    }
+    return InvalidIndex;
+}
+
+//------------------------------------------------------------------------------
+int
+animSequencer::activeClips(double curTime, int* outClipIndices) const {
+    int num = 0;
+    for (const auto& item : this->items) {
+        if (isActive(item, curTime)) {
+            outClipIndices[num++] = item.clipIndex;
+        }
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------------
+bool
+animSequencer::eval(const AnimLibrary* lib, double curTime, float* sampleBuffer, int numSamples, float* velocityBuffer, animKeyCache* keyCache, int lod) {
+    o_assert_dbg(numSamples <= AnimConfig::MaxNumCurvesInClip * 4);
+    if (velocityBuffer) {
+        return this->evalVelocity(lib, curTime, sampleBuffer, velocityBuffer, numSamples, keyCache, lod);
+    }
+
+    // for each item which crosses the current play time...
+    // FIXME: currently items are evaluated even if they are culled
+    // completely by higher priority items
+    float smp[AnimConfig::MaxNumCurvesInClip * 4];
+    int numProcessedItems = 0;
+    for (const auto& item : this->items) {
+        if (!isActive(item, curTime)) {
+            continue;
+        }
+        const AnimClip& clip = lib->Clips[item.clipIndex];
+        // the first processed track only needs to be sampled, following
+        // tracks are sampled into a scratch buffer and mixed with the previous result
+        float* dst = (0 == numProcessedItems) ? sampleBuffer : smp;
+        const int clipLodIndex = clipLod(clip, lod);
+        if (clipLodIndex > 0) {
+            sampleLodKeys(clip, clipLodIndex, curTime - item.absStartTime, dst);
+        }
+        else {
+            int key0, key1;
+            double keyPos;
+            sampleParams(clip, curTime - item.absStartTime, key0, key1, keyPos);
+            sampleKeysCached(clip, key0, key1, float(keyPos), dst, keyCache);
+        }
+        if (isMirrored(item, lib, this->mirrorSkeleton)) {
+            mirrorSamples(lib, this->mirrorSkeleton, dst);
+        }
+        if (numProcessedItems > 0) {
+            // FIXME: may need to do proper quaternion slerp when mixing
+            // rotation curves
+            const float weight = itemWeight(item, curTime);
+            for (int i = 0; i < numSamples; i++) {
+                const float s0 = sampleBuffer[i];
+                sampleBuffer[i] = s0 + (smp[i] - s0) * weight;
+            }
+        }
+        numProcessedItems++;
+    }
+    return numProcessedItems > 0;
+}
+
+//------------------------------------------------------------------------------
+bool
+animSequencer::evalVelocity(const AnimLibrary* lib, double curTime, float* sampleBuffer, float* velocityBuffer, int numSamples, animKeyCache* keyCache, int lod) {
+    o_assert_dbg(numSamples <= AnimConfig::MaxNumCurvesInClip * 4);
+
+    // same as eval, but also computes the velocities from the same
+    // key fetches, the mixing derivative is:
+    //
+    //  s = s0 + (x - s0) * w
+    //  ds/dt = ds0 + (dx - ds0) * w + (x - s0) * dw/dt
+    //
+    float smp[AnimConfig::MaxNumCurvesInClip * 4];
+    float vel[AnimConfig::MaxNumCurvesInClip * 4];
+    int numProcessedItems = 0;
+    for (const auto& item : this->items) {
+        if (!isActive(item, curTime)) {
+            continue;
+        }
+        const AnimClip& clip = lib->Clips[item.clipIndex];
+        float* dst = (0 == numProcessedItems) ? sampleBuffer : smp;
+        float* dstVel = (0 == numProcessedItems) ? velocityBuffer : vel;
+        const int clipLodIndex = clipLod(clip, lod);
+        if (clipLodIndex > 0) {
+            sampleLodKeysVelocity(clip, clipLodIndex, curTime - item.absStartTime, dst, dstVel);
+        }
+        else {
+            int key0, key1;
+            double keyPos;
+            sampleParams(clip, curTime - item.absStartTime, key0, key1, keyPos);
+            sampleKeysVelocity(clip, key0, key1, float(keyPos), dst, dstVel, keyCache);
+        }
+        if (isMirrored(item, lib, this->mirrorSkeleton)) {
+            mirrorSamples(lib, this->mirrorSkeleton, dst);
+            mirrorSamples(lib, this->mirrorSkeleton, dstVel);
+        }
+        if (numProcessedItems > 0) {
+            const float weight = itemWeight(item, curTime);
+            const float weightVelocity = itemWeightVelocity(item, curTime);
+            for (int i = 0; i < numSamples; i++) {
+                const float s0 = sampleBuffer[i];
+                const float v0 = velocityBuffer[i];
+                sampleBuffer[i] = s0 + (smp[i] - s0) * weight;
+                velocityBuffer[i] = v0 + (vel[i] - v0) * weight + (smp[i] - s0) * weightVelocity;
+            }
+        }
+        numProcessedItems++;
+    }
+    if (0 == numProcessedItems) {
+        for (int i = 0; i < numSamples; i++) {
+            velocityBuffer[i] = 0.0f;
+        }
+    }
+    return numProcessedItems > 0;
+}
+
+//------------------------------------------------------------------------------
+bool
+animSequencer::evalFixed(const AnimLibrary* lib, double curTime, float* sampleBuffer, int numSamples, int32_t* fixedSampleBuffer) {
+    o_assert_dbg(numSamples <= AnimConfig::MaxNumCurvesInClip * 4);
+
+    // samples are accumulated as Q16.16 and only converted to float at
+    // the end, each item is first sampled into a scratch buffer and 
+    // then mixed in a separate, branch-free loop
+    int32_t accum[AnimConfig::MaxNumCurvesInClip * 4];
+    int32_t smp[AnimConfig::MaxNumCurvesInClip * 4];
+    int numProcessedItems = 0;
+    for (const auto& item : this->items) {
+        if (!isActive(item, curTime)) {
+            continue;
+        }
+        const AnimClip& clip = lib->Clips[item.clipIndex];
+        int key0, key1;
+        double keyPos;
+        sampleParams(clip, curTime - item.absStartTime, key0, key1, keyPos);
+        const bool mirrored = isMirrored(item, lib, this->mirrorSkeleton);
+        if (0 == numProcessedItems) {
+            sampleKeysFixed(clip, key0, key1, animFixed::fromUnit(keyPos), accum);
+            if (mirrored) {
+                mirrorSamples(lib, this->mirrorSkeleton, accum);
+            }
+        }
+        else {
+            sampleKeysFixed(clip, key0, key1, animFixed::fromUnit(keyPos), smp);
+            if (mirrored) {
+                mirrorSamples(lib, this->mirrorSkeleton, smp);
+            }
+            const int32_t weight = itemWeightFixed(item, curTime);
+            for (int i = 0; i < numSamples; i++) {
+                accum[i] = animFixed::lerp(accum[i], smp[i], weight);
+            }
         }
-        #endif
         numProcessedItems++;
     }
+    if (numProcessedItems > 0) {
+        for (int i = 0; i < numSamples; i++) {
+            sampleBuffer[i] = animFixed::toFloat(accum[i]);
+        }
+        if (fixedSampleBuffer) {
+            Memory::Copy(accum, fixedSampleBuffer, numSamples * sizeof(int32_t));
+        }
+    }
     return numProcessedItems > 0;
 }
 
+//------------------------------------------------------------------------------
+static glm::vec4
+rootMotionOffset(const AnimLibrary* lib, const AnimClip& clip, double clipTime) {
+    // compute the accumulated root motion displacement from clip start
+    // to clipTime (including full loops), the displacement table has
+    // one entry per key plus one for the end of the clip
+    o_assert_dbg(InvalidIndex != clip.RootMotionIndex);
+    const glm::vec4* table = &(lib->RootMotion[clip.RootMotionIndex + 1]);
+    const double clipDuration = clip.Length * clip.KeyDuration;
+    const double numLoops = floor(clipTime / clipDuration);
+    const double loopTime = clipTime - numLoops * clipDuration;
+    int key = int(loopTime / clip.KeyDuration);
+    if (key < 0) key = 0;
+    else if (key >= clip.Length) key = clip.Length - 1;
+    const float keyPos = float((loopTime - key * clip.KeyDuration) / clip.KeyDuration);
+    return table[clip.Length] * float(numLoops) + table[key] + (table[key+1] - table[key]) * keyPos;
+}
+
+//------------------------------------------------------------------------------
+bool
+animSequencer::evalRootMotion(const AnimLibrary* lib, double prevTime, double curTime, float* sampleBuffer, float* velocityBuffer, glm::vec4& outDelta) {
+    o_assert_dbg(InvalidIndex != lib->RootMotionCurve);
+
+    // mix the root motion of all active items the same way as the
+    // samples are mixed in eval(), and mix the root curve's reference
+    // values, which replace the sampled root curve values, items which
+    // ended since prevTime contribute their root motion until their end
+    glm::vec4 delta(0.0f), ref(0.0f);
+    int numDeltaItems = 0;
+    int numProcessedItems = 0;
+    for (const auto& item : this->items) {
+        const bool active = isActive(item, curTime);
+        if (!active && !isExpiring(item, prevTime, curTime)) {
+            continue;
+        }
+        const double endTime = active ? curTime : item.absEndTime;
+        const AnimClip& clip = lib->Clips[item.clipIndex];
+        glm::vec4 itemDelta(0.0f), itemRef;
+        if (InvalidIndex == clip.RootMotionIndex) {
+            const AnimCurve& curve = clip.Curves[lib->RootMotionCurve];
+            itemRef = glm::vec4(curve.StaticValue[0], curve.StaticValue[1], curve.StaticValue[2], curve.StaticValue[3]);
+        }
+        else {
+            const double t0 = (prevTime > item.absStartTime ? prevTime : item.absStartTime) - item.absStartTime;
+            const double t1 = endTime - item.absStartTime;
+            itemDelta = rootMotionOffset(lib, clip, t1) - rootMotionOffset(lib, clip, t0);
+            itemRef = lib->RootMotion[clip.RootMotionIndex];
+        }
+        if (isMirrored(item, lib, this->mirrorSkeleton)) {
+            // the root curve is expected to be the translation of a self-mirrored bone
+            const int axis = this->mirrorSkeleton->MirrorAxis;
+            itemDelta[axis] = -itemDelta[axis];
+            itemRef[axis] = -itemRef[axis];
+        }
+        if (0 == numDeltaItems) {
+            delta = itemDelta;
+        }
+        else {
+            delta += (itemDelta - delta) * itemWeight(item, endTime);
+        }
+        numDeltaItems++;
+        if (active) {
+            if (0 == numProcessedItems) {
+                ref = itemRef;
+            }
+            else {
+                ref += (itemRef - ref) * itemWeight(item, curTime);
+            }
+            numProcessedItems++;
+        }
+    }
+    outDelta = glm::vec4(0.0f);
+    const int numValues = AnimCurveFormat::Stride(lib->CurveLayout[lib->RootMotionCurve]);
+    for (int i = 0; i < numValues; i++) {
+        outDelta[i] = delta[i] * lib->RootMotionMask[i];
+    }
+    if (numProcessedItems > 0) {
+        // sampleBuffer is null if the samples have already been stripped
+        if (sampleBuffer) {
+            float* smp = sampleBuffer + lib->RootMotionSampleIndex;
+            for (int i = 0; i < numValues; i++) {
+                const float mask = lib->RootMotionMask[i];
+                smp[i] += (ref[i] - smp[i]) * mask;
+            }
+        }
+        if (velocityBuffer) {
+            float* vel = velocityBuffer + lib->RootMotionSampleIndex;
+            for (int i = 0; i < numValues; i++) {
+                vel[i] *= 1.0f - lib->RootMotionMask[i];
+            }
+        }
+    }
+    return numDeltaItems > 0;
+}
+
+//------------------------------------------------------------------------------
+static void
+rootMotionOffsetFixed(const AnimLibrary* lib, const AnimClip& clip, double clipTime, int64_t* outOffset) {
+    // fixed-point version of rootMotionOffset(), the displacement table
+    // has 4 Q16.16 values per entry, the result is Q16.16 in 64 bits
+    // since it includes the displacement of all full loops
+    o_assert_dbg(InvalidIndex != clip.RootMotionIndex);
+    const int32_t* table = &(lib->FixedRootMotion[(clip.RootMotionIndex + 1) * 4]);
+    const double clipDuration = clip.Length * clip.KeyDuration;
+    const double numLoops = floor(clipTime / clipDuration);
+    const double loopTime = clipTime - numLoops * clipDuration;
+    int key = int(loopTime / clip.KeyDuration);
+    if (key < 0) key = 0;
+    else if (key >= clip.Length) key = clip.Length - 1;
+    const int32_t keyPos = animFixed::fromUnit((loopTime - key * clip.KeyDuration) / clip.KeyDuration);
+    const int32_t* v0 = table + key * 4;
+    const int32_t* v1 = v0 + 4;
+    const int32_t* loop = table + clip.Length * 4;
+    for (int i = 0; i < 4; i++) {
+        outOffset[i] = int64_t(loop[i]) * int64_t(numLoops) + v0[i] + animFixed::roundShift(int64_t(v1[i] - v0[i]) * keyPos, animFixed::UnitBits);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+animSequencer::evalRootMotionFixed(const AnimLibrary* lib, double prevTime, double curTime, float* sampleBuffer, int32_t* fixedSampleBuffer, glm::vec4& outDelta) {
+    o_assert_dbg(InvalidIndex != lib->RootMotionCurve);
+    o_assert_dbg((nullptr == sampleBuffer) == (nullptr == fixedSampleBuffer));
+
+    // same as evalRootMotion(), but the displacements are mixed as
+    // Q16.16 in 64 bits with the same weights as evalFixed()
+    int64_t delta[4] = { 0, 0, 0, 0 };
+    int32_t ref[4] = { 0, 0, 0, 0 };
+    int numDeltaItems = 0;
+    int numProcessedItems = 0;
+    for (const auto& item : this->items) {
+        const bool active = isActive(item, curTime);
+        if (!active && !isExpiring(item, prevTime, curTime)) {
+            continue;
+        }
+        const double endTime = active ? curTime : item.absEndTime;
+        const AnimClip& clip = lib->Clips[item.clipIndex];
+        int64_t itemDelta[4] = { 0, 0, 0, 0 };
+        int32_t itemRef[4];
+        if (InvalidIndex == clip.RootMotionIndex) {
+            const AnimCurve& curve = clip.Curves[lib->RootMotionCurve];
+            for (int i = 0; i < 4; i++) {
+                itemRef[i] = curve.FixedStaticValue[i];
+            }
+        }
+        else {
+            const double t0 = (prevTime > item.absStartTime ? prevTime : item.absStartTime) - item.absStartTime;
+            const double t1 = endTime - item.absStartTime;
+            int64_t offset0[4], offset1[4];
+            rootMotionOffsetFixed(lib, clip, t0, offset0);
+            rootMotionOffsetFixed(lib, clip, t1, offset1);
+            for (int i = 0; i < 4; i++) {
+                itemDelta[i] = offset1[i] - offset0[i];
+                itemRef[i] = lib->FixedRootMotion[clip.RootMotionIndex * 4 + i];
+            }
+        }
+        if (isMirrored(item, lib, this->mirrorSkeleton)) {
+            const int axis = this->mirrorSkeleton->MirrorAxis;
+            itemDelta[axis] = -itemDelta[axis];
+            itemRef[axis] = -itemRef[axis];
+        }
+        if (0 == numDeltaItems) {
+            for (int i = 0; i < 4; i++) {
+                delta[i] = itemDelta[i];
+            }
+        }
+        else {
+            const int32_t weight = itemWeightFixed(item, endTime);
+            for (int i = 0; i < 4; i++) {
+                delta[i] += animFixed::roundShift((itemDelta[i] - delta[i]) * weight, animFixed::UnitBits);
+            }
+        }
+        numDeltaItems++;
+        if (active) {
+            if (0 == numProcessedItems) {
+                for (int i = 0; i < 4; i++) {
+                    ref[i] = itemRef[i];
+                }
+            }
+            else {
+                const int32_t weight = itemWeightFixed(item, curTime);
+                for (int i = 0; i < 4; i++) {
+                    ref[i] = animFixed::lerp(ref[i], itemRef[i], weight);
+                }
+            }
+            numProcessedItems++;
+        }
+    }
+    outDelta = glm::vec4(0.0f);
+    const int numValues = AnimCurveFormat::Stride(lib->CurveLayout[lib->RootMotionCurve]);
+    for (int i = 0; i < numValues; i++) {
+        outDelta[i] = float(double(delta[i]) / double(animFixed::One)) * lib->RootMotionMask[i];
+    }
+    if (numProcessedItems > 0) {
+        // the buffers are null if the samples have already been stripped
+        if (fixedSampleBuffer) {
+            int32_t* fixedSmp = fixedSampleBuffer + lib->RootMotionSampleIndex;
+            float* smp = sampleBuffer + lib->RootMotionSampleIndex;
+            for (int i = 0; i < numValues; i++) {
+                fixedSmp[i] = animFixed::lerp(fixedSmp[i], ref[i], animFixed::fromUnit(lib->RootMotionMask[i]));
+                smp[i] = animFixed::toFloat(fixedSmp[i]);
+            }
+        }
+    }
+    return numDeltaItems > 0;
+}
+
 } // namespace _priv
 } // namespace Oryol
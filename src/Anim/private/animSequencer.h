@@ -12,6 +12,8 @@
 namespace Oryol {
 namespace _priv {
 
+class animKeyCache;
+
 class animSequencer {
 public:
     /// a track item for evaluating an anim job
@@ -34,11 +36,19 @@ public:
         double absFadeInTime = 0.0;
         /// the absolute time when fade-out starts
         double absFadeOutTime = 0.0;
+        /// play the clip mirrored
+        bool mirror = false;
     };
     /// max number of items that can be queued
     static const int maxItems = 16;
+    /// time quantization of encoded items (ticks per second)
+    static const int encodeTicksPerSecond = 1024;
+    /// max number of bytes for an encoded sequencer state
+    static const int maxEncodedBytes = 1 + maxItems * 64;
     /// room for enqueued items
     InlineArray<item, maxItems> items;
+    /// skeleton with the mirror map for mirrored items (mirrored items play unmirrored if null)
+    const AnimSkeleton* mirrorSkeleton = nullptr;
 
     /// enqueue a new anim job, return false if queue is full, or job was dropped
     bool add(double curTime, AnimJobId jobId, const AnimJob& job, double clipDuration);
@@ -50,8 +60,41 @@ public:
     void stopAll(double curTime, bool allowFadeOut);
     /// remove invalid and expired items
     void garbageCollect(double curTime);
-    /// evaluate all active anim jobs into sample buffer, return false if there was nothing to do
-    bool eval(const AnimLibrary* lib, double curTime, float* sampleBuffer, int numSamples);
+    /// encode items into compact byte stream (optionally delta to baseline), return num bytes or 0 on error
+    int encode(uint8_t* dst, int maxBytes, const animSequencer* baseline) const;
+    /// decode items from compact byte stream (baseline must match the one used for encoding)
+    bool decode(const uint8_t* src, int numBytes, const animSequencer* baseline);
+    /// return pointer to item if exactly one item is active at curTime, otherwise nullptr
+    const item* singleActiveItem(double curTime) const;
+    /// hash the inputs of eval() at curTime (active clips, LODs, keys, key positions and weights) into hash
+    uint64_t evalSignature(const AnimLibrary* lib, double curTime, int lod, uint64_t hash) const;
+    /// return clip index of first active item at curTime, or InvalidIndex
+    int firstActiveClip(double curTime) const;
+    /// write clip indices of all active items at curTime (max maxItems), return number of clips
+    int activeClips(double curTime, int* outClipIndices) const;
+    /// evaluate all active anim jobs into sample buffer (optional velocities, key cache, and reduced-rate clip LOD), return false if there was nothing to do
+    bool eval(const AnimLibrary* lib, double curTime, float* sampleBuffer, int numSamples, float* velocityBuffer=nullptr, animKeyCache* keyCache=nullptr, int lod=0);
+    /// same as eval, but also computes the per-second velocity of each sample value
+    bool evalVelocity(const AnimLibrary* lib, double curTime, float* sampleBuffer, float* velocityBuffer, int numSamples, animKeyCache* keyCache=nullptr, int lod=0);
+    /// compute root motion between prevTime and curTime (including items which ended in between), and strip it from the samples and velocities (if not null)
+    bool evalRootMotion(const AnimLibrary* lib, double prevTime, double curTime, float* sampleBuffer, float* velocityBuffer, glm::vec4& outDelta);
+    /// same as eval, but with deterministic fixed-point math (optionally also writes the Q16.16 samples)
+    bool evalFixed(const AnimLibrary* lib, double curTime, float* sampleBuffer, int numSamples, int32_t* fixedSampleBuffer=nullptr);
+    /// same as evalRootMotion, but with deterministic fixed-point math, strips the float and Q16.16 samples (if not null)
+    bool evalRootMotionFixed(const AnimLibrary* lib, double prevTime, double curTime, float* sampleBuffer, int32_t* fixedSampleBuffer, glm::vec4& outDelta);
+
+    /// sample a single clip at a clip-relative time (same kernel as eval, times rounding to a key snap to the key)
+    static void sample(const AnimClip& clip, double clipTime, float* sampleBuffer, int numSamples);
+    /// sample a single clip at a clip-relative time (same kernel as evalFixed, times rounding to a key snap to the key)
+    static void sampleFixed(const AnimClip& clip, double clipTime, float* sampleBuffer, int numSamples);
+    /// sample a single clip at a clip-relative time exactly like eval (no key snapping, optional key cache)
+    static void sampleCached(const AnimClip& clip, double clipTime, float* sampleBuffer, animKeyCache* keyCache);
+    /// compute the 2 keys and the position between them for a clip-relative time (same as used for sampling)
+    static void keyParams(const AnimClip& clip, double clipTime, int& key0, int& key1, double& keyPos);
+    /// sample the same clip for many instances at different clip-relative times (one SIMD lane per instance, gathers from hot or cached key rows)
+    static void sampleGroup(const AnimClip& clip, const double* clipTimes, float* const* sampleBuffers, int num, animKeyCache* keyCache=nullptr);
+    /// max number of instances sampled in lockstep by sampleGroup
+    static const int maxSampleGroupLanes = 16;
 };
 
 } // namespace _priv
@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+//  animWorkerPool.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "animWorkerPool.h"
+
+namespace Oryol {
+namespace _priv {
+
+//------------------------------------------------------------------------------
+animWorkerPool::~animWorkerPool() {
+    if (this->valid) {
+        this->discard();
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animWorkerPool::setup(int numWorkers) {
+    o_assert_dbg(!this->valid);
+    o_assert_dbg((numWorkers >= 0) && (numWorkers <= maxWorkers));
+    this->valid = true;
+    #if ORYOL_HAS_THREADS
+    this->quit = false;
+    this->num = numWorkers;
+    for (int i = 0; i < this->num; i++) {
+        this->workers[i] = std::thread(&animWorkerPool::workerLoop, this);
+    }
+    #else
+    this->num = 0;
+    #endif
+}
+
+//------------------------------------------------------------------------------
+void
+animWorkerPool::discard() {
+    o_assert_dbg(this->valid);
+    #if ORYOL_HAS_THREADS
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->quit = true;
+    }
+    this->wakeCond.notify_all();
+    for (int i = 0; i < this->num; i++) {
+        this->workers[i].join();
+    }
+    #endif
+    this->num = 0;
+    this->valid = false;
+}
+
+//------------------------------------------------------------------------------
+void
+animWorkerPool::run(chunkFunc chunkFn, void* data, int numChunksToRun) {
+    o_assert_dbg(this->valid && chunkFn);
+    #if ORYOL_HAS_THREADS
+    std::unique_lock<std::mutex> lock(this->mutex);
+    o_assert_dbg(this->nextChunk == this->numChunks);
+    this->func = chunkFn;
+    this->userData = data;
+    this->numChunks = numChunksToRun;
+    this->nextChunk = 0;
+    this->numDoneChunks = 0;
+    this->wakeCond.notify_all();
+    this->processChunks(lock);
+    this->doneCond.wait(lock, [this] { return this->numDoneChunks == this->numChunks; });
+    this->func = nullptr;
+    this->userData = nullptr;
+    #else
+    for (int i = 0; i < numChunksToRun; i++) {
+        chunkFn(data, i);
+    }
+    #endif
+}
+
+#if ORYOL_HAS_THREADS
+//------------------------------------------------------------------------------
+void
+animWorkerPool::processChunks(std::unique_lock<std::mutex>& lock) {
+    // chunks are coarse, so they are simply handed out under the lock
+    while (this->nextChunk < this->numChunks) {
+        const int chunkIndex = this->nextChunk++;
+        chunkFunc chunkFn = this->func;
+        void* data = this->userData;
+        lock.unlock();
+        chunkFn(data, chunkIndex);
+        lock.lock();
+        if (++this->numDoneChunks == this->numChunks) {
+            this->doneCond.notify_all();
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animWorkerPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true) {
+        this->wakeCond.wait(lock, [this] { return this->quit || (this->nextChunk < this->numChunks); });
+        if (this->quit) {
+            return;
+        }
+        this->processChunks(lock);
+    }
+}
+#endif
+
+} // namespace _priv
+} // namespace Oryol
@@ -0,0 +1,80 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::_priv::animWorkerPool
+    @ingroup _priv
+    @brief persistent worker threads for splitting work into chunks
+
+    The worker threads are started once in setup() and sleep until
+    run() hands out chunks of work, the calling thread of run() works
+    on chunks too, and run() returns when all chunks are done. run()
+    must not be called from several threads at the same time. Without
+    ORYOL_HAS_THREADS there are no workers, and run() processes all
+    chunks on the calling thread.
+*/
+#include "Core/Types.h"
+#if ORYOL_HAS_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+namespace Oryol {
+namespace _priv {
+
+class animWorkerPool {
+public:
+    /// max number of worker threads
+    static const int maxWorkers = 15;
+    /// a chunk function, called with the userData pointer passed to run()
+    typedef void (*chunkFunc)(void* userData, int chunkIndex);
+
+    /// destructor
+    ~animWorkerPool();
+    /// start the worker threads
+    void setup(int numWorkers);
+    /// stop and join the worker threads
+    void discard();
+    /// return true if the worker threads have been started
+    bool isValid() const;
+    /// return the number of worker threads
+    int numWorkers() const;
+    /// call func for numChunks chunks on the workers and the calling thread, return when all chunks are done
+    void run(chunkFunc func, void* userData, int numChunks);
+
+private:
+    #if ORYOL_HAS_THREADS
+    /// the worker thread function
+    void workerLoop();
+    /// process chunks until all have been handed out (lock must be held)
+    void processChunks(std::unique_lock<std::mutex>& lock);
+
+    std::thread workers[maxWorkers];
+    std::mutex mutex;
+    std::condition_variable wakeCond;
+    std::condition_variable doneCond;
+    chunkFunc func = nullptr;
+    void* userData = nullptr;
+    int numChunks = 0;
+    int nextChunk = 0;
+    int numDoneChunks = 0;
+    bool quit = false;
+    #endif
+    int num = 0;
+    bool valid = false;
+};
+
+//------------------------------------------------------------------------------
+inline bool
+animWorkerPool::isValid() const {
+    return this->valid;
+}
+
+//------------------------------------------------------------------------------
+inline int
+animWorkerPool::numWorkers() const {
+    return this->num;
+}
+
+} // namespace _priv
+} // namespace Oryol